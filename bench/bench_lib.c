@@ -0,0 +1,167 @@
+// Benchmarks of lib/string.c and lib/printfmt.c, run on the host
+// The host libc implementation of each function is timed as a reference
+
+#include "harness.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+// lib/ functions renamed by bench/prefix.h
+// JOS' size_t is a 32-bit unsigned integer
+int jos_strlen(const char *s);
+int jos_strnlen(const char *s, uint32_t size);
+int jos_strcmp(const char *p, const char *q);
+int jos_strncmp(const char *p, const char *q, uint32_t n);
+char *jos_strchr(const char *s, char c);
+char *jos_strfind(const char *s, char c);
+void *jos_memset(void *v, int c, uint32_t n);
+void *jos_memmove(void *dst, const void *src, uint32_t n);
+int jos_memcmp(const void *v1, const void *v2, uint32_t n);
+void jos_vprintfmt(void (*putch)(int, void*), void *putdat,
+    const char *fmt, va_list ap);
+
+#define BUFSIZE 16384
+// Strings are built in `src` and copied to `dst`
+// Memory functions write to `scratch`
+static char src[BUFSIZE], dst[BUFSIZE], scratch[BUFSIZE];
+
+struct StrArg {
+  const char *s; // NUL-terminated string of `len` bytes
+  const char *t; // Copy of `s`
+  size_t len;
+};
+
+static struct StrArg make_str(size_t len, size_t src_off, size_t dst_off) {
+  for (size_t i = 0; i < len; i++) src[src_off + i] = 'a' + i % 26;
+  src[src_off + len] = '\0';
+  memcpy(dst + dst_off, src + src_off, len + 1);
+  return (struct StrArg){ src + src_off, dst + dst_off, len };
+}
+
+// Define bench_<name>_jos and bench_<name>_libc, each of them
+// evaluating `expr` with `f` bound to the respective implementation
+#define DEFINE_PAIR(name, jos_fn, libc_fn, expr) \
+  static void bench_##name##_jos(void *arg, uint64_t iters) { \
+    struct StrArg *a = arg; \
+    for (uint64_t i = 0; i < iters; i++) { \
+      __typeof__(&jos_fn) volatile fp = jos_fn; \
+      __typeof__(&jos_fn) f = fp; \
+      bench_use(expr); \
+    } \
+  } \
+  static void bench_##name##_libc(void *arg, uint64_t iters) { \
+    struct StrArg *a = arg; \
+    for (uint64_t i = 0; i < iters; i++) { \
+      __typeof__(&libc_fn) volatile fp = libc_fn; \
+      __typeof__(&libc_fn) f = fp; \
+      bench_use(expr); \
+    } \
+  }
+
+DEFINE_PAIR(strlen, jos_strlen, strlen, f(a->s))
+DEFINE_PAIR(strnlen, jos_strnlen, strnlen, f(a->s, a->len / 2))
+DEFINE_PAIR(strcmp, jos_strcmp, strcmp, f(a->s, a->t))
+DEFINE_PAIR(strncmp, jos_strncmp, strncmp, f(a->s, a->t, a->len))
+DEFINE_PAIR(strchr, jos_strchr, strchr, f(a->s, '#'))
+DEFINE_PAIR(memset, jos_memset, memset, f(scratch, 0, a->len))
+DEFINE_PAIR(memmove, jos_memmove, memmove, f(scratch, a->s, a->len))
+DEFINE_PAIR(memmove_overlap, jos_memmove, memmove, f(scratch + 64, scratch, a->len))
+DEFINE_PAIR(memcmp, jos_memcmp, memcmp, f(a->s, a->t, a->len))
+
+// strfind has no libc counterpart; strchrnul behaves the same
+static void bench_strfind_jos(void *arg, uint64_t iters) {
+  struct StrArg *a = arg;
+  for (uint64_t i = 0; i < iters; i++) bench_use(jos_strfind(a->s, '#'));
+}
+
+static void bench_strfind_libc(void *arg, uint64_t iters) {
+  struct StrArg *a = arg;
+  for (uint64_t i = 0; i < iters; i++) bench_use(strchrnul(a->s, '#'));
+}
+
+/**** printfmt ****/
+
+struct PrintBuf {
+  char *buf;
+  char *ebuf;
+};
+
+static void sprintputch(int ch, void *arg) {
+  struct PrintBuf *b = arg;
+  if (b->buf < b->ebuf) *b->buf++ = ch;
+}
+
+static void jos_snprintf(char *buf, int n, const char *fmt, ...) {
+  struct PrintBuf b = { buf, buf + n - 1 };
+  va_list ap;
+  va_start(ap, fmt);
+  jos_vprintfmt(sprintputch, &b, fmt, ap);
+  va_end(ap);
+  *b.buf = '\0';
+}
+
+#define LINE_FMT "%s - %08x (virt) %d %u %s\n"
+#define LINE_ARGS "kerninfo", 0xf0100000, -42, 1234567u, "Display infomation"
+
+static void bench_printfmt_jos(void *arg, uint64_t iters) {
+  for (uint64_t i = 0; i < iters; i++) {
+    jos_snprintf(scratch, BUFSIZE, LINE_FMT, LINE_ARGS);
+    bench_use(scratch);
+  }
+}
+
+static void bench_printfmt_libc(void *arg, uint64_t iters) {
+  for (uint64_t i = 0; i < iters; i++) {
+    snprintf(scratch, BUFSIZE, LINE_FMT, LINE_ARGS);
+    bench_use(scratch);
+  }
+}
+
+#define RUN_PAIR(label, name, arg) do { \
+  bench_run(label, "jos", bench_##name##_jos, arg); \
+  bench_run(label, "libc", bench_##name##_libc, arg); \
+} while(0)
+
+int main(int argc, char **argv) {
+  bench_init("lib", argc, argv);
+  
+  static const size_t lens[] = { 16, 256, 4096 };
+  for (int i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+    char label[64];
+    struct StrArg a = make_str(lens[i], 0, 0);
+    // Misaligned start and a copy at a different alignment
+    struct StrArg u = make_str(lens[i], BUFSIZE / 2 + 1, BUFSIZE / 2 + 2);
+    
+#define RUN(name, arg) \
+    snprintf(label, sizeof(label), #name "/%zu%s", lens[i], \
+        (arg) == &u ? "/unaligned" : ""); \
+    RUN_PAIR(label, name, arg)
+    
+    RUN(strlen, &a);
+    RUN(strlen, &u);
+    RUN(strnlen, &a);
+    RUN(strcmp, &a);
+    RUN(strcmp, &u);
+    RUN(strncmp, &a);
+    RUN(strchr, &a);
+    RUN(strfind, &a);
+    RUN(memset, &a);
+    RUN(memmove, &a);
+    RUN(memmove_overlap, &a);
+    RUN(memcmp, &a);
+#undef RUN
+  }
+  // The timings mean nothing if the formatter disagrees with libc
+  char got[128], want[128];
+  jos_snprintf(got, sizeof(got), LINE_FMT, LINE_ARGS);
+  snprintf(want, sizeof(want), LINE_FMT, LINE_ARGS);
+  if (strcmp(got, want) != 0) {
+    fprintf(stderr, "printfmt: got \"%s\", expected \"%s\"\n", got, want);
+    return 1;
+  }
+  RUN_PAIR("printfmt/line", printfmt, NULL);
+  
+  bench_finish();
+  return 0;
+}
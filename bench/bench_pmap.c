@@ -0,0 +1,212 @@
+// Benchmarks of kern/pmap.c, run on the host against simulated memory
+// See bench/pmap_sim.c for how the kernel code is hosted
+
+#include "harness.h"
+#include "pmap_sim.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TOTALMEM_KB (128 * 1024)
+
+// Virtual addresses used by the benchmarks; all below UTOP
+#define VA_BASE (2 * PTSIZE)
+#define VA(i) ((void*)(uintptr_t)(VA_BASE + (uint32_t)(i) * PGSIZE))
+#define VA_UNMAPPED ((void*)(uintptr_t)(64 * PTSIZE))
+
+/**** Kernel functions used by kern/pmap.c ****/
+
+int cprintf(const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  int cnt = vprintf(fmt, ap);
+  va_end(ap);
+  return cnt;
+}
+
+void _panic(const char *file, int line, const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  fprintf(stderr, "Kernel panic at %s:%d ", file, line);
+  vfprintf(stderr, fmt, ap);
+  fprintf(stderr, "\n");
+  va_end(ap);
+  abort();
+}
+
+void _warn(const char *file, int line, const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  fprintf(stderr, "Kernel warning at %s:%d ", file, line);
+  vfprintf(stderr, fmt, ap);
+  fprintf(stderr, "\n");
+  va_end(ap);
+}
+
+#define check(x) do { if (!(x)) _panic(__FILE__, __LINE__, "%s", #x); } while(0)
+
+/**** Benchmarks ****/
+
+static void bench_alloc_free(void *arg, uint64_t iters) {
+  int flags = *(int*)arg;
+  for (uint64_t i = 0; i < iters; i++) {
+    struct PageInfo *pp = page_alloc(flags);
+    page_free(pp);
+  }
+}
+
+static void bench_walk(void *arg, uint64_t iters) {
+  void *va = arg;
+  for (uint64_t i = 0; i < iters; i++) {
+    bench_use(pgdir_walk(kern_pgdir, va, 0));
+  }
+}
+
+static void bench_lookup(void *arg, uint64_t iters) {
+  for (uint64_t i = 0; i < iters; i++) {
+    bench_use(page_lookup(kern_pgdir, VA(i % NPTENTRIES), NULL));
+  }
+}
+
+static void bench_insert_remove(void *arg, uint64_t iters) {
+  struct PageInfo *pp = arg;
+  for (uint64_t i = 0; i < iters; i++) {
+    page_insert(kern_pgdir, pp, VA(NPTENTRIES), PTE_W | PTE_U);
+    page_remove(kern_pgdir, VA(NPTENTRIES));
+  }
+}
+
+// Map `iters` pages at consecutive addresses, then unmap them
+// Page tables are allocated on first use and never freed
+static void bench_insert_remove_seq(void *arg, uint64_t iters) {
+  struct PageInfo *pp = arg;
+  const uint32_t window = 16 * NPTENTRIES;
+  for (uint64_t done = 0; done < iters; ) {
+    uint32_t n = iters - done < window ? iters - done : window;
+    for (uint32_t i = 0; i < n; i++) {
+      page_insert(kern_pgdir, pp, VA(2 * NPTENTRIES + i), PTE_W | PTE_U);
+    }
+    for (uint32_t i = 0; i < n; i++) {
+      page_remove(kern_pgdir, VA(2 * NPTENTRIES + i));
+    }
+    done += n;
+  }
+}
+
+// One operation maps a 4MiB region
+static void bench_boot_map_region(void *arg, uint64_t iters) {
+  for (uint64_t i = 0; i < iters; i++) {
+    sim_boot_map_region(kern_pgdir, 32 * PTSIZE, PTSIZE, 0, PTE_W);
+  }
+}
+
+/**** Randomized workload checked against a shadow mapping ****/
+
+#define MIX_NSLOTS (4 * NPTENTRIES)
+#define MIX_NPAGES 256
+
+static struct PageInfo *mix_shadow[MIX_NSLOTS];
+static struct PageInfo *mix_pages[MIX_NPAGES];
+static uint32_t mix_seed = 1;
+
+static uint32_t mix_rand(void) {
+  mix_seed = mix_seed * 1103515245 + 12345;
+  return mix_seed >> 8;
+}
+
+static void mix_init(void) {
+  // Hold one reference to every page so that page_remove never frees it
+  for (int i = 0; i < MIX_NPAGES; i++) {
+    check((mix_pages[i] = page_alloc(0)));
+    mix_pages[i]->pp_ref++;
+  }
+}
+
+static void mix_check(void) {
+  static int expected[MIX_NPAGES];
+  for (int i = 0; i < MIX_NPAGES; i++) expected[i] = 1;
+  for (int i = 0; i < MIX_NSLOTS; i++) {
+    check(page_lookup(kern_pgdir, VA(8 * NPTENTRIES + i), NULL) ==
+        mix_shadow[i]);
+    for (int j = 0; mix_shadow[i] && j < MIX_NPAGES; j++) {
+      if (mix_pages[j] == mix_shadow[i]) expected[j]++;
+    }
+  }
+  for (int i = 0; i < MIX_NPAGES; i++) {
+    check(mix_pages[i]->pp_ref == expected[i]);
+  }
+}
+
+static void mix_finish(void) {
+  for (int i = 0; i < MIX_NSLOTS; i++) {
+    page_remove(kern_pgdir, VA(8 * NPTENTRIES + i));
+    mix_shadow[i] = NULL;
+  }
+  mix_check();
+  for (int i = 0; i < MIX_NPAGES; i++) page_decref(mix_pages[i]);
+}
+
+static void bench_random_mix(void *arg, uint64_t iters) {
+  for (uint64_t i = 0; i < iters; i++) {
+    uint32_t r = mix_rand();
+    uint32_t slot = (r >> 2) % MIX_NSLOTS;
+    void *va = VA(8 * NPTENTRIES + slot);
+    switch (r & 3) {
+    case 0:
+    case 1: {
+      struct PageInfo *pp = mix_pages[(r >> 16) % MIX_NPAGES];
+      check(page_insert(kern_pgdir, pp, va, PTE_W | PTE_U) == 0);
+      mix_shadow[slot] = pp;
+      break;
+    }
+    case 2:
+      page_remove(kern_pgdir, va);
+      mix_shadow[slot] = NULL;
+      break;
+    case 3:
+      check(page_lookup(kern_pgdir, va, NULL) == mix_shadow[slot]);
+      break;
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  // mem_init's self-tests run here
+  sim_mem_init(TOTALMEM_KB);
+  uint32_t nfree = sim_nfree_pages();
+  
+  bench_init("pmap", argc, argv);
+  
+  int flags = 0;
+  bench_run("page_alloc+page_free", "jos", bench_alloc_free, &flags);
+  flags = ALLOC_ZERO;
+  bench_run("page_alloc(ZERO)+page_free", "jos", bench_alloc_free, &flags);
+  
+  struct PageInfo *pp = page_alloc(ALLOC_ZERO);
+  check(pp);
+  pp->pp_ref++;
+  for (int i = 0; i < NPTENTRIES; i++) {
+    check(page_insert(kern_pgdir, pp, VA(i), PTE_W | PTE_U) == 0);
+  }
+  bench_run("pgdir_walk/hit", "jos", bench_walk, VA(1));
+  bench_run("pgdir_walk/miss", "jos", bench_walk, VA_UNMAPPED);
+  bench_run("page_lookup", "jos", bench_lookup, NULL);
+  bench_run("page_insert+page_remove", "jos", bench_insert_remove, pp);
+  bench_run("page_insert+page_remove/seq", "jos", bench_insert_remove_seq, pp);
+  bench_run("boot_map_region/4MiB", "jos", bench_boot_map_region, NULL);
+  
+  mix_init();
+  bench_run("random_mix", "jos", bench_random_mix, NULL);
+  mix_check();
+  mix_finish();
+  
+  bench_finish();
+  
+  for (int i = 0; i < NPTENTRIES; i++) page_remove(kern_pgdir, VA(i));
+  check(pp->pp_ref == 1);
+  page_decref(pp);
+  printf("invlpg: %u, free pages: %u before, %u after "
+      "(difference is page tables)\n", sim_ninvlpg, nfree, sim_nfree_pages());
+  return 0;
+}
@@ -0,0 +1,125 @@
+// Correctness fuzz of the word-at-a-time string functions of
+// lib/string.c against the host libc, run by bench-host
+// Strings are placed at random alignments, many of them ending right
+// before an unmapped guard page, so that a read past the terminator
+// that leaves the page faults instead of going unnoticed.
+// Usage: fuzz_string [seed]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// lib/ functions renamed by bench/prefix.h
+// JOS' size_t is a 32-bit unsigned integer
+int jos_strlen(const char *s);
+int jos_strnlen(const char *s, uint32_t size);
+int jos_strcmp(const char *p, const char *q);
+int jos_strncmp(const char *p, const char *q, uint32_t n);
+char *jos_strchr(const char *s, char c);
+char *jos_strfind(const char *s, char c);
+
+#define NITERS 200000
+#define MAXLEN 300
+
+static size_t pgsize;
+static int nfailed;
+
+// Return a buffer of `len` bytes ending right before a guard page
+static char *guarded_buf(size_t len) {
+  size_t npages = (len + pgsize - 1) / pgsize + 1;
+  char *p = mmap(NULL, npages * pgsize, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) {
+    perror("mmap");
+    exit(1);
+  }
+  char *guard = p + (npages - 1) * pgsize;
+  if (mprotect(guard, pgsize, PROT_NONE) < 0) {
+    perror("mprotect");
+    exit(1);
+  }
+  return guard - len;
+}
+
+// Random bytes other than '\0', including ones above 0x7f so that
+// comparisons have to treat them as unsigned
+static char random_char(void) {
+  return 1 + random() % 255;
+}
+
+static size_t random_len(void) {
+  return random() % 4 == 0 ? random() % (MAXLEN + 1) : random() % 17;
+}
+
+// Build a string of `len` bytes in `buf`, which holds `size` bytes,
+// either at a random offset or ending right before the end of `buf`
+static char *place(char *buf, size_t size, size_t len) {
+  size_t off = random() % 2 ? size - len - 1 : random() % (size - len);
+  char *s = buf + off;
+  for (size_t i = 0; i < len; i++) s[i] = random_char();
+  s[len] = '\0';
+  return s;
+}
+
+static int sign(int x) {
+  return (x > 0) - (x < 0);
+}
+
+#define CHECK(name, got, want, s, len) do { \
+  if ((got) != (want)) { \
+    fprintf(stderr, "%s: got %ld, expected %ld (offset %ld, len %zu)\n", \
+        name, (long)(got), (long)(want), (long)((uintptr_t)(s) % 8), len); \
+    nfailed++; \
+  } \
+} while (0)
+
+int main(int argc, char **argv) {
+  unsigned seed = argc > 1 ? strtoul(argv[1], NULL, 0) : 1;
+  srandom(seed);
+  pgsize = sysconf(_SC_PAGESIZE);
+  size_t size = MAXLEN + 64;
+  char *a = guarded_buf(size), *b = guarded_buf(size);
+  
+  for (int i = 0; i < NITERS && nfailed < 10; i++) {
+    size_t len = random_len();
+    char *s = place(a, size, len);
+    
+    CHECK("strlen", jos_strlen(s), strlen(s), s, len);
+    uint32_t n = random() % (len + 8);
+    CHECK("strnlen", jos_strnlen(s, n), strnlen(s, n), s, len);
+    
+    // Search for a byte of the string, or a random one, or the terminator
+    char c = len && random() % 2 ? s[random() % len] : random_char();
+    CHECK("strchr", jos_strchr(s, c), strchr(s, c), s, len);
+    if (random() % 8 == 0) c = '\0';
+    CHECK("strfind", jos_strfind(s, c), strchrnul(s, c), s, len);
+    
+    // Compare with a copy at another alignment, which is a shorter
+    // prefix or has a byte changed some of the time
+    size_t tlen = len && random() % 4 == 0 ? random() % len : len;
+    char *t = place(b, size, tlen);
+    memcpy(t, s, tlen);
+    if (tlen && random() % 2) t[random() % tlen] = random_char();
+    CHECK("strcmp", sign(jos_strcmp(s, t)), sign(strcmp(s, t)), s, len);
+    CHECK("strcmp", sign(jos_strcmp(t, s)), sign(strcmp(t, s)), t, len);
+    n = random() % (len + 8);
+    CHECK("strncmp", sign(jos_strncmp(s, t, n)), sign(strncmp(s, t, n)),
+        s, len);
+    
+    // Bytes up to the guard page without a terminator, which strnlen
+    // must not read past when its limit ends there
+    char *u = a + size - len;
+    for (size_t j = 0; j < len; j++) u[j] = random_char();
+    CHECK("strnlen", jos_strnlen(u, len), len, u, len);
+  }
+  
+  if (nfailed) {
+    fprintf(stderr, "fuzz_string: seed %u failed\n", seed);
+    return 1;
+  }
+  printf("fuzz_string: %d iterations passed (seed %u)\n", NITERS, seed);
+  return 0;
+}
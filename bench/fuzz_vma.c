@@ -0,0 +1,244 @@
+// Correctness fuzz of the area tree of kern/vma.c against a model kept
+// as a sorted array, run by bench-host
+// Random inserts, removes and copies over a few dozen pages merge, trim
+// and split areas often; after each one the tree is checked to be a
+// balanced search tree holding exactly the areas of the model, and
+// lookups are checked at random addresses. Some operations run out of
+// memory, which must leave the areas unchanged, or for copies leave the
+// destination without areas.
+// See bench/vma_sim.c for how the kernel code is hosted.
+// Usage: fuzz_vma [seed]
+
+#include "vma_sim.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NOPS 200000
+#define NPAGES 64
+#define VA_BASE 0x10000000
+#define VA(page) (VA_BASE + (uint32_t)(page) * 4096)
+#define PTE_W 0x2
+#define PTE_U 0x4
+
+/**** Kernel functions used by kern/vma.c ****/
+
+int cprintf(const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  int cnt = vprintf(fmt, ap);
+  va_end(ap);
+  return cnt;
+}
+
+void _panic(const char *file, int line, const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  fprintf(stderr, "Kernel panic at %s:%d ", file, line);
+  vfprintf(stderr, fmt, ap);
+  fprintf(stderr, "\n");
+  va_end(ap);
+  abort();
+}
+
+void _warn(const char *file, int line, const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  fprintf(stderr, "Kernel warning at %s:%d ", file, line);
+  vfprintf(stderr, fmt, ap);
+  fprintf(stderr, "\n");
+  va_end(ap);
+}
+
+/**** Model ****/
+
+// The areas of an environment in address order
+struct Model {
+  struct SimVma vmas[NPAGES];
+  int n;
+};
+
+static struct Model models[SIM_NENVS];
+
+static void model_delete(struct Model *m, int i) {
+  memmove(&m->vmas[i], &m->vmas[i + 1], (m->n - i - 1) * sizeof(m->vmas[0]));
+  m->n--;
+}
+
+static void model_add(struct Model *m, int i, const struct SimVma *v) {
+  memmove(&m->vmas[i + 1], &m->vmas[i], (m->n - i) * sizeof(m->vmas[0]));
+  m->vmas[i] = *v;
+  m->n++;
+}
+
+static void model_set_start(struct SimVma *v, uint32_t start) {
+  if (v->type == SIM_VMA_FILE) v->file += start - v->start;
+  v->start = start;
+}
+
+static bool model_continues(const struct SimVma *a, const struct SimVma *b) {
+  return a->end == b->start && a->type == b->type && a->perm == b->perm &&
+    (a->type != SIM_VMA_FILE || a->file + (a->end - a->start) == b->file);
+}
+
+static int model_insert(struct Model *m, const struct SimVma *v, bool nomem) {
+  int i = 0;
+  while (i < m->n && m->vmas[i].end <= v->start) i++;
+  if (i < m->n && m->vmas[i].start < v->end) return -SIM_E_INVAL;
+  struct SimVma *prev = i > 0 ? &m->vmas[i - 1] : NULL;
+  struct SimVma *next = i < m->n ? &m->vmas[i] : NULL;
+  bool merge_prev = prev && model_continues(prev, v);
+  bool merge_next = next && model_continues(v, next);
+  if (merge_prev && merge_next) {
+    prev->end = next->end;
+    model_delete(m, i);
+  } else if (merge_prev) {
+    prev->end = v->end;
+  } else if (merge_next) {
+    model_set_start(next, v->start);
+  } else {
+    if (nomem) return -SIM_E_NO_MEM;
+    model_add(m, i, v);
+  }
+  return 0;
+}
+
+static int model_remove(struct Model *m, uint32_t start, uint32_t end,
+    bool nomem) {
+  for (int i = 0; i < m->n; i++) {
+    struct SimVma *v = &m->vmas[i];
+    if (v->start < start && v->end > end) {
+      if (nomem) return -SIM_E_NO_MEM;
+      struct SimVma w = *v;
+      model_set_start(&w, end);
+      v->end = start;
+      model_add(m, i + 1, &w);
+      return 0;
+    }
+  }
+  for (int i = 0; i < m->n; i++) {
+    struct SimVma *v = &m->vmas[i];
+    if (v->end <= start || v->start >= end) continue;
+    if (v->start < start) {
+      v->end = start;
+    } else if (v->end <= end) {
+      model_delete(m, i--);
+    } else {
+      model_set_start(v, end);
+    }
+  }
+  return 0;
+}
+
+/**** Checks ****/
+
+static uint32_t nops;
+static unsigned seed;
+
+static void fail(const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  fprintf(stderr, "fuzz_vma: operation %u: ", nops);
+  vfprintf(stderr, fmt, ap);
+  fprintf(stderr, "\nfuzz_vma: seed %u failed\n", seed);
+  va_end(ap);
+  exit(1);
+}
+
+static bool vma_equal(const struct SimVma *a, const struct SimVma *b) {
+  return a->start == b->start && a->end == b->end && a->type == b->type &&
+    a->perm == b->perm && a->file == b->file;
+}
+
+static void check_env(int env) {
+  struct Model *m = &models[env];
+  struct SimVma vmas[NPAGES];
+  int n = sim_vma_list(env, vmas, NPAGES);
+  if (n != m->n) fail("env %d has %d areas, expected %d", env, n, m->n);
+  for (int i = 0; i < n; i++) {
+    if (!vma_equal(&vmas[i], &m->vmas[i])) {
+      fail("env %d area %d is [%x, %x) type %d perm %x file %x, "
+          "expected [%x, %x) type %d perm %x file %x", env, i,
+          vmas[i].start, vmas[i].end, vmas[i].type, vmas[i].perm,
+          vmas[i].file, m->vmas[i].start, m->vmas[i].end, m->vmas[i].type,
+          m->vmas[i].perm, m->vmas[i].file);
+    }
+  }
+  
+  // Lookups inside areas, at their edges and in the gaps
+  for (int i = 0; i < 4; i++) {
+    uint32_t va = VA(-1) + random() % ((NPAGES + 2) * 4096);
+    const struct SimVma *want = NULL;
+    for (int j = 0; j < m->n; j++) {
+      if (m->vmas[j].start <= va && va < m->vmas[j].end) want = &m->vmas[j];
+    }
+    struct SimVma got;
+    bool found = sim_vma_lookup(env, va, &got);
+    if (found != (want != NULL) || (found && !vma_equal(&got, want))) {
+      fail("env %d lookup of %x is wrong", env, va);
+    }
+  }
+}
+
+/**** Operations ****/
+
+// A range of 1 to 8 pages, or up to all of them now and then
+static void random_range(uint32_t *start, uint32_t *end) {
+  int first = random() % NPAGES;
+  int maxlen = NPAGES - first;
+  if (random() % 8 && maxlen > 8) maxlen = 8;
+  *start = VA(first);
+  *end = VA(first + 1 + random() % maxlen);
+}
+
+int main(int argc, char **argv) {
+  seed = argc > 1 ? strtoul(argv[1], NULL, 0) : 1;
+  srandom(seed);
+  
+  for (nops = 0; nops < NOPS; nops++) {
+    int env = random() % SIM_NENVS;
+    struct Model *m = &models[env];
+    int op = random() % 8;
+    int r, want, dst = op == 7 ? 1 - env : -1;
+    // The child of a fork starts out with no areas
+    if (dst >= 0) sim_vma_free(dst);
+    // Out of memory now and then, copies after allocating part of the tree
+    int navail = -1;
+    if (random() % 16 == 0) navail = op == 7 ? random() % (m->n + 1) : 0;
+    bool nomem = navail == 0;
+    sim_vma_set_nomem(navail);
+    if (op < 4) {
+      // Few kinds of areas, so that neighbours are often merged: files
+      // are mostly mapped at the offset of their page, so are contiguous
+      struct SimVma v;
+      random_range(&v.start, &v.end);
+      v.type = random() % 2 ? SIM_VMA_ZERO : SIM_VMA_FILE;
+      v.perm = random() % 2 ? PTE_U : PTE_U | PTE_W;
+      v.file = 0;
+      if (v.type == SIM_VMA_FILE) {
+        v.file = v.start - VA_BASE;
+        if (random() % 4 == 0) v.file += (random() % NPAGES) * 4096;
+      }
+      r = sim_vma_insert(env, v.start, v.end, v.type, v.perm, v.file);
+      want = model_insert(m, &v, nomem);
+    } else if (op < 7) {
+      uint32_t start, end;
+      random_range(&start, &end);
+      r = sim_vma_remove(env, start, end);
+      want = model_remove(m, start, end, nomem);
+    } else {
+      r = sim_vma_copy(dst, env);
+      want = navail >= 0 && navail < m->n ? -SIM_E_NO_MEM : 0;
+      models[dst] = want ? (struct Model){ .n = 0 } : *m;
+    }
+    sim_vma_set_nomem(-1);
+    if (r != want) fail("operation %d returned %d, expected %d", op, r, want);
+    check_env(env);
+    if (dst >= 0) check_env(dst);
+  }
+  
+  printf("fuzz_vma: %d operations passed (seed %u)\n", NOPS, seed);
+  return 0;
+}
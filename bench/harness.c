@@ -0,0 +1,118 @@
+#include "harness.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static struct BenchConfig config = {
+  .warmup = 3,
+  .reps = 31,
+  .min_rep_ns = 2000000,
+  .json_path = NULL,
+};
+static const char *suite;
+static FILE *json;
+static int nresults;
+
+uint64_t bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void bench_init(const char *name, int argc, char **argv) {
+  int opt;
+  while ((opt = getopt(argc, argv, "w:r:t:o:")) != -1) {
+    switch (opt) {
+    case 'w': config.warmup = atoi(optarg); break;
+    case 'r': config.reps = atoi(optarg); break;
+    case 't': config.min_rep_ns = strtoull(optarg, NULL, 10) * 1000; break;
+    case 'o': config.json_path = optarg; break;
+    default:
+      fprintf(stderr, "usage: %s [-w warmup] [-r reps] [-t min_rep_us] "
+          "[-o results.json]\n", argv[0]);
+      exit(2);
+    }
+  }
+  if (config.reps < 1) config.reps = 1;
+  
+  suite = name;
+  if (config.json_path) {
+    if (!(json = fopen(config.json_path, "w"))) {
+      perror(config.json_path);
+      exit(1);
+    }
+    fprintf(json, "{\"suite\": \"%s\", \"warmup\": %d, \"reps\": %d, "
+        "\"results\": [", suite, config.warmup, config.reps);
+  }
+  printf("%-28s %-6s %10s %10s %10s %10s %10s %14s\n", "benchmark", "impl",
+      "min", "p50", "p90", "p99", "max", "ops/s");
+}
+
+void bench_finish(void) {
+  if (json) {
+    fprintf(json, "\n]}\n");
+    fclose(json);
+    printf("Results written to %s\n", config.json_path);
+  }
+}
+
+static int cmp_double(const void *a, const void *b) {
+  double x = *(const double*)a, y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted samples
+static double percentile(double *sorted, int n, double q) {
+  int rank = (int)(q * n + 0.999999);
+  if (rank < 1) rank = 1;
+  if (rank > n) rank = n;
+  return sorted[rank - 1];
+}
+
+void bench_report(const char *name, const char *impl,
+    double *ns_per_op, int nsamples, uint64_t ops) {
+  qsort(ns_per_op, nsamples, sizeof(double), cmp_double);
+  double p50 = percentile(ns_per_op, nsamples, 0.50);
+  double p90 = percentile(ns_per_op, nsamples, 0.90);
+  double p99 = percentile(ns_per_op, nsamples, 0.99);
+  double min = ns_per_op[0], max = ns_per_op[nsamples - 1];
+  double ops_per_sec = p50 > 0 ? 1e9 / p50 : 0;
+  
+  printf("%-28s %-6s %10.2f %10.2f %10.2f %10.2f %10.2f %14.0f\n",
+      name, impl, min, p50, p90, p99, max, ops_per_sec);
+  if (json) {
+    fprintf(json, "%s\n  {\"name\": \"%s\", \"impl\": \"%s\", "
+        "\"samples\": %d, \"ops\": %llu, \"unit\": \"ns/op\", "
+        "\"min\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, "
+        "\"max\": %.3f, \"ops_per_sec\": %.1f}",
+        nresults++ ? "," : "", name, impl, nsamples,
+        (unsigned long long)ops, min, p50, p90, p99, max, ops_per_sec);
+  }
+}
+
+void bench_run(const char *name, const char *impl,
+    void (*fn)(void *arg, uint64_t iters), void *arg) {
+  // Calibrate the number of iterations in one repetition
+  uint64_t iters = 1;
+  while (1) {
+    uint64_t start = bench_now_ns();
+    fn(arg, iters);
+    if (bench_now_ns() - start >= config.min_rep_ns || iters >= (1ULL << 40)) {
+      break;
+    }
+    iters *= 2;
+  }
+  
+  for (int i = 0; i < config.warmup; i++) fn(arg, iters);
+  
+  double samples[config.reps];
+  for (int i = 0; i < config.reps; i++) {
+    uint64_t start = bench_now_ns();
+    fn(arg, iters);
+    samples[i] = (double)(bench_now_ns() - start) / iters;
+  }
+  bench_report(name, impl, samples, config.reps, iters * config.reps);
+}
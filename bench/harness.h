@@ -0,0 +1,37 @@
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+// A tiny benchmark harness for code compiled to run on the host.
+// Every case is warmed up, then timed for a number of repetitions.
+// The iteration count of a repetition is calibrated so that one
+// repetition takes at least `min_rep_ns`. Per-operation latencies of the
+// repetitions are summarized as percentiles, printed as a table and
+// appended to a JSON results file.
+
+#include <stdint.h>
+
+struct BenchConfig {
+  int warmup; // Number of untimed repetitions
+  int reps; // Number of timed repetitions
+  uint64_t min_rep_ns; // Minimum duration of one repetition
+  const char *json_path; // Where to write results, or NULL
+};
+
+// Parse -w warmup, -r reps, -t min_rep_us and -o json_path
+void bench_init(const char *suite, int argc, char **argv);
+void bench_finish(void);
+
+// Time `fn(arg, iters)`, which must perform `iters` operations
+void bench_run(const char *name, const char *impl,
+    void (*fn)(void *arg, uint64_t iters), void *arg);
+
+// Record samples measured by the caller, e.g. one latency per operation
+void bench_report(const char *name, const char *impl,
+    double *ns_per_op, int nsamples, uint64_t ops);
+
+uint64_t bench_now_ns(void);
+
+// Keep the compiler from optimizing away a value or memory contents
+#define bench_use(x) asm volatile("" : : "g"(x) : "memory")
+
+#endif // BENCH_HARNESS_H
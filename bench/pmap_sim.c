@@ -0,0 +1,143 @@
+// Hosted build of kern/pmap.c
+//
+// kern/pmap.c is included as is, so that its static functions are
+// reachable, with the following pieces replaced:
+//  * Physical memory is a static arena `physmem` and KADDR/PADDR
+//    translate between physical addresses and offsets into it
+//  * The "kernel image" occupies [EXTPHYSMEM, SIM_KERN_END) of the arena;
+//    `bootstack` and the `end` symbol used by boot_alloc live there
+//  * Privileged instructions only update counters
+//  * The CMOS reports a configurable amount of memory
+
+#include <inc/x86.h>
+#include <inc/error.h>
+#include <kern/pmap.h>
+#include <kern/kclock.h>
+
+#define SIM_MAXMEM (256 * 1024 * 1024) // Must not exceed -KERNBASE
+#define SIM_KERN_END (2 * 1024 * 1024)
+#define SIM_BOOTSTACK (SIM_KERN_END - KSTKSIZE)
+
+#define STR(x) #x
+#define XSTR(x) STR(x)
+
+__attribute__((__aligned__(PGSIZE)))
+static char physmem[SIM_MAXMEM];
+extern char sim_end[], sim_bootstack[];
+asm(".set sim_end, physmem + " XSTR(SIM_KERN_END));
+asm(".set sim_bootstack, physmem + " XSTR(SIM_BOOTSTACK));
+
+// kern/env.c is not part of the simulator
+struct Env *envs;
+
+void env_destroy(struct Env *e) {
+  panic("env_destroy is not simulated");
+}
+
+int vma_fault(struct Env *e, uintptr_t va, uint32_t err) {
+  return -E_FAULT;
+}
+
+static size_t sim_totalmem_kb;
+uint32_t sim_ninvlpg; // Number of invlpg instructions executed
+uint32_t sim_nlcr3; // Number of writes to %cr3
+
+static inline void* sim_kaddr(const char *file, int line, physaddr_t pa) {
+  if (PGNUM(pa) >= npages) {
+    _panic(file, line, "KADDR called with invalid pa %08lx", pa);
+  }
+  return physmem + pa;
+}
+
+static inline physaddr_t sim_paddr(const char *file, int line, void *kva) {
+  if ((char*)kva < physmem || (char*)kva >= physmem + SIM_MAXMEM) {
+    _panic(file, line, "PADDR called with invalid kva %p", kva);
+  }
+  return (char*)kva - physmem;
+}
+
+static inline void sim_invlpg(void *va) {
+  sim_ninvlpg++;
+}
+
+static inline void sim_lcr3(uint32_t val) {
+  sim_nlcr3++;
+}
+
+#undef KADDR
+#undef PADDR
+#define KADDR(pa) sim_kaddr(__FILE__, __LINE__, pa)
+#define PADDR(kva) sim_paddr(__FILE__, __LINE__, kva)
+#define page2kva(pp) KADDR(page2pa(pp))
+#define invlpg(va) sim_invlpg(va)
+#define lcr3(val) sim_lcr3(val)
+#define rcr0() 0
+#define lcr0(val) ((void)(val))
+#define end sim_end
+#define bootstack sim_bootstack
+
+#include <kern/pmap.c>
+
+#undef end
+#undef bootstack
+
+// NVRAM registers read by i386_detect_memory
+unsigned mc146818_read(unsigned reg) {
+  size_t basemem = 640;
+  size_t extmem = sim_totalmem_kb > 16 * 1024 ? 15 * 1024 : 0;
+  size_t ext16mem = sim_totalmem_kb > 16 * 1024 ?
+      (sim_totalmem_kb - 16 * 1024) / 64 : 0;
+  switch (reg) {
+  case NVRAM_BASELO: return basemem & 0xFF;
+  case NVRAM_BASELO+1: return basemem >> 8;
+  case NVRAM_EXTLO: return extmem & 0xFF;
+  case NVRAM_EXTLO+1: return extmem >> 8;
+  case NVRAM_EXT16LO: return ext16mem & 0xFF;
+  case NVRAM_EXT16LO+1: return ext16mem >> 8;
+  default: return 0;
+  }
+}
+
+void mc146818_write(unsigned reg, unsigned datum) {}
+
+// Same as mem_init up to the point where the kernel switches to
+// kern_pgdir; the simulator never loads it into %cr3
+void sim_mem_init(size_t totalmem_kb) {
+  assert(totalmem_kb > 16 * 1024 && totalmem_kb * 1024 <= SIM_MAXMEM);
+  sim_totalmem_kb = totalmem_kb;
+  i386_detect_memory();
+  
+  kern_pgdir = (pde_t*)boot_alloc(PGSIZE);
+  memset(kern_pgdir, 0, PGSIZE);
+  kern_pgdir[PDX(UVPT)] = PADDR(kern_pgdir) | PTE_U | PTE_P;
+  
+  pages = (struct PageInfo*)boot_alloc(npages * sizeof(struct PageInfo));
+  memset(pages, 0, npages * sizeof(struct PageInfo));
+  
+  envs = (struct Env*)boot_alloc(NENV * sizeof(struct Env));
+  memset(envs, 0, NENV * sizeof(struct Env));
+  
+  page_init();
+  check_page_free_list(1);
+  check_page_alloc();
+  check_page();
+  
+  boot_map_region(kern_pgdir, UPAGES, PTSIZE, PADDR(pages), PTE_U);
+  boot_map_region(kern_pgdir, UENVS, PTSIZE, PADDR(envs), PTE_U);
+  boot_map_region(
+      kern_pgdir, KSTACKTOP-KSTKSIZE, KSTKSIZE, PADDR(sim_bootstack), PTE_W);
+  boot_map_region(kern_pgdir, KERNBASE, -KERNBASE, 0, PTE_W);
+  check_kern_pgdir();
+  check_page_free_list(0);
+}
+
+void sim_boot_map_region(
+    pde_t *pgdir, uintptr_t va, size_t size, physaddr_t pa, int perm) {
+  boot_map_region(pgdir, va, size, pa, perm);
+}
+
+size_t sim_nfree_pages(void) {
+  size_t n = 0;
+  for (struct PageInfo *pp = page_free_list; pp; pp = pp->pp_link) n++;
+  return n;
+}
@@ -0,0 +1,48 @@
+#ifndef BENCH_PMAP_SIM_H
+#define BENCH_PMAP_SIM_H
+
+// Host-side view of kern/pmap.c as built by bench/pmap_sim.c
+// Declarations mirror kern/pmap.h, inc/memlayout.h and inc/mmu.h
+// with JOS' 32-bit size_t, physaddr_t, pte_t and pde_t spelled as uint32_t
+// JOS headers themselves clash with the host's <stdint.h>
+
+#include <stdint.h>
+
+#define NPTENTRIES 1024
+#define PGSIZE 4096
+#define PTSIZE (PGSIZE*NPTENTRIES)
+#define PTE_P 0x1
+#define PTE_W 0x2
+#define PTE_U 0x4
+
+struct PageInfo {
+  struct PageInfo *pp_link;
+  uint32_t pp_ref;
+};
+
+enum {
+  ALLOC_ZERO = 1<<0
+};
+
+extern uint32_t *kern_pgdir;
+extern struct PageInfo *pages;
+extern uint32_t npages;
+
+struct PageInfo *page_alloc(int alloc_flags);
+void page_free(struct PageInfo *pp);
+int page_insert(uint32_t *pgdir, struct PageInfo *pp, void *va, int perm);
+int page_remove(uint32_t *pgdir, void *va);
+struct PageInfo *page_lookup(uint32_t *pgdir, void *va, uint32_t **pte_store);
+void page_decref(struct PageInfo *pp);
+uint32_t *pgdir_walk(uint32_t *pgdir, const void *va, int create);
+
+extern uint32_t sim_ninvlpg;
+extern uint32_t sim_nlcr3;
+
+// Run mem_init on a machine with `totalmem_kb` KiB of memory
+void sim_mem_init(uint32_t totalmem_kb);
+void sim_boot_map_region(
+    uint32_t *pgdir, uint32_t va, uint32_t size, uint32_t pa, int perm);
+uint32_t sim_nfree_pages(void);
+
+#endif // BENCH_PMAP_SIM_H
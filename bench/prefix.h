@@ -0,0 +1,29 @@
+#ifndef BENCH_PREFIX_H
+#define BENCH_PREFIX_H
+
+// Force-included when lib/*.c is compiled for the host,
+// so that its symbols do not clash with the ones of the host libc
+
+// lib/string.c
+#define strlen jos_strlen
+#define strnlen jos_strnlen
+#define strcpy jos_strcpy
+#define strncpy jos_strncpy
+#define strcat jos_strcat
+#define strlcpy jos_strlcpy
+#define strcmp jos_strcmp
+#define strncmp jos_strncmp
+#define strchr jos_strchr
+#define strfind jos_strfind
+#define memset jos_memset
+#define memcpy jos_memcpy
+#define memmove jos_memmove
+#define memcmp jos_memcmp
+#define memfind jos_memfind
+#define strtol jos_strtol
+
+// lib/printfmt.c
+#define printfmt jos_printfmt
+#define vprintfmt jos_vprintfmt
+
+#endif // BENCH_PREFIX_H
@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+"""Run the in-kernel benchmarks under QEMU and compare them to a baseline.
+
+The boot arguments "bench=<suite>" are written into a copy of the boot
+image (see BOOTARGS in inc/memlayout.h). The kernel then runs the selected
+benchmarks, prints one JSON object per line on QEMU's debug console and
+exits QEMU through the isa-debug-exit device.
+"""
+
+import argparse
+import json
+import os
+import shutil
+import subprocess
+import sys
+
+BOOTARGS_OFFSET = 446
+BOOTARGS_LEN = 64
+
+
+def make_image(image, out, bootargs):
+    data = bytearray(open(image, "rb").read())
+    args = bootargs.encode("ascii")
+    if len(args) >= BOOTARGS_LEN:
+        sys.exit("boot arguments too long: %r" % bootargs)
+    region = data[BOOTARGS_OFFSET:BOOTARGS_OFFSET + BOOTARGS_LEN]
+    if any(region):
+        sys.exit("%s: boot block overlaps the boot arguments" % image)
+    data[BOOTARGS_OFFSET:BOOTARGS_OFFSET + len(args)] = args
+    open(out, "wb").write(data)
+
+
+def run_qemu(qemu, image, log, timeout, extra):
+    if os.path.exists(log):
+        os.remove(log)
+    cmd = [qemu, "-display", "none", "-no-reboot",
+           "-drive", "file=%s,index=0,media=disk,format=raw" % image,
+           "-debugcon", "file:%s" % log,
+           "-device", "isa-debug-exit,iobase=0xf4,iosize=0x04"] + extra
+    try:
+        status = subprocess.call(cmd, timeout=timeout)
+    except subprocess.TimeoutExpired:
+        sys.exit("QEMU did not exit within %d seconds" % timeout)
+    # isa-debug-exit makes QEMU exit with (value << 1) | 1
+    if status != 1:
+        sys.exit("QEMU exited with status %d" % status)
+
+    results = []
+    done = False
+    for line in open(log):
+        line = line.strip()
+        if not line.startswith("{"):
+            continue
+        obj = json.loads(line)
+        if obj.get("done"):
+            done = True
+        else:
+            results.append(obj)
+    if not done:
+        sys.exit("%s: benchmark run did not complete" % log)
+    return results
+
+
+def compare(results, baseline, threshold):
+    base = {r["name"]: r for r in baseline["results"]}
+    regressions = 0
+    print("%-28s %12s %12s %8s" % ("benchmark", "baseline", "median", "change"))
+    for r in results:
+        b = base.get(r["name"])
+        if b is None or b["median"] == 0:
+            print("%-28s %12s %12d %8s" % (r["name"], "-", r["median"], "new"))
+            continue
+        change = (r["median"] - b["median"]) / float(b["median"])
+        mark = ""
+        if change > threshold:
+            mark = " REGRESSION"
+            regressions += 1
+        print("%-28s %12d %12d %+7.1f%%%s" %
+              (r["name"], b["median"], r["median"], change * 100, mark))
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("image", help="boot image, e.g. build/image")
+    parser.add_argument("--suite", default="all",
+                        help="comma separated benchmark name prefixes")
+    parser.add_argument("--qemu", default="qemu-system-i386")
+    parser.add_argument("--qemu-opts", default="",
+                        help="extra QEMU options, e.g. '-cpu max'")
+    parser.add_argument("--outdir", default="build/bench")
+    parser.add_argument("--timeout", type=int, default=300)
+    parser.add_argument("--baseline", help="baseline results to compare with")
+    parser.add_argument("--save-baseline", action="store_true",
+                        help="store the results as the baseline")
+    parser.add_argument("--threshold", type=float, default=0.10,
+                        help="relative slowdown of the median reported "
+                             "as a regression")
+    args = parser.parse_args()
+
+    if not os.path.isdir(args.outdir):
+        os.makedirs(args.outdir)
+    image = os.path.join(args.outdir, "image")
+    log = os.path.join(args.outdir, "qemu.jsonl")
+    out = os.path.join(args.outdir, "qemu.json")
+
+    make_image(args.image, image, "bench=" + args.suite)
+    results = run_qemu(args.qemu, image, log, args.timeout,
+                       args.qemu_opts.split())
+    doc = {"suite": args.suite, "results": results}
+    with open(out, "w") as f:
+        json.dump(doc, f, indent=2)
+    print("Results written to %s" % out)
+
+    if args.save_baseline:
+        shutil.copyfile(out, args.baseline)
+        print("Baseline saved to %s" % args.baseline)
+        return 0
+    if args.baseline and os.path.exists(args.baseline):
+        regressions = compare(results, json.load(open(args.baseline)),
+                              args.threshold)
+        return 1 if regressions else 0
+    for r in results:
+        print("%-28s %12d cycles" % (r["name"], r["median"]))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
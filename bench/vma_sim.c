@@ -0,0 +1,192 @@
+// Hosted build of kern/vma.c
+//
+// kern/vma.c is included as is, so that its static functions are
+// reachable, with the following pieces replaced:
+//  * Pages for areas come from a static arena `simpages`, and the
+//    allocation of areas can be made to fail to exercise the -E_NO_MEM
+//    paths
+//  * Areas belong to the environments of a static array `simenvs`
+//  * Page faults and the in-kernel benchmarks are not simulated
+// The checks of the tree itself are done here, where struct Vma is
+// known; bench/fuzz_vma.c drives them against a model.
+
+#include <inc/error.h>
+#include <inc/assert.h>
+#include <kern/vma.h>
+#include <kern/env.h>
+#include <kern/pmap.h>
+
+#define SIM_NPAGES 64
+
+// Must match bench/vma_sim.h
+#define SIM_NENVS 2
+#define SIM_FILESIZE (1024 * PGSIZE)
+#define SIM_VMA_ZERO 1
+#define SIM_VMA_FILE 2
+#define SIM_E_INVAL 3
+#define SIM_E_NO_MEM 4
+
+__attribute__((__aligned__(PGSIZE)))
+static char simpages[SIM_NPAGES][PGSIZE];
+static struct PageInfo simpageinfo[SIM_NPAGES];
+static int sim_npages_used;
+static bool sim_nomem;
+
+static struct Env simenvs[SIM_NENVS];
+// VMA_FILE areas point into this, which is never read
+static uint8_t simfile[SIM_FILESIZE];
+
+static struct PageInfo* sim_page_alloc(int alloc_flags) {
+  if (sim_nomem) return NULL;
+  if (sim_npages_used == SIM_NPAGES) panic("sim_page_alloc: arena full");
+  return &simpageinfo[sim_npages_used++];
+}
+
+static void* sim_page2kva(struct PageInfo *pp) {
+  return simpages[pp - simpageinfo];
+}
+
+#define page_alloc(flags) sim_page_alloc(flags)
+#define page2kva(pp) sim_page2kva(pp)
+
+#include <kern/vma.c>
+
+#undef page_alloc
+#undef page2kva
+
+// Kernel functions used by the parts of kern/vma.c not simulated
+struct PageInfo *pages;
+size_t npages;
+
+pte_t* pgdir_walk(pde_t *pgdir, const void *va, int create) {
+  return NULL;
+}
+
+int page_insert(pde_t *pgdir, struct PageInfo *pp, void *va, int perm) {
+  return -E_NO_MEM;
+}
+
+void page_free(struct PageInfo *pp) {
+  panic("page_free is not simulated");
+}
+
+int page_remove_range(pde_t *pgdir, uintptr_t start, uintptr_t end) {
+  return -E_NO_MEM;
+}
+
+int env_alloc(struct Env **newenv_store, envid_t parent_id) {
+  return -E_NO_FREE_ENV;
+}
+
+void env_free(struct Env *e) {
+  panic("env_free is not simulated");
+}
+
+// Mirrors bench/vma_sim.h
+struct SimVma {
+  uint32_t start;
+  uint32_t end;
+  int type;
+  int perm;
+  uint32_t file; // VMA_FILE: offset of the contents of start
+};
+
+static int sim_err(int r) {
+  static_assert(E_INVAL == SIM_E_INVAL && E_NO_MEM == SIM_E_NO_MEM);
+  static_assert(VMA_ZERO == SIM_VMA_ZERO && VMA_FILE == SIM_VMA_FILE);
+  return r;
+}
+
+// Make the allocation of areas fail after `navail` more, or never again
+// if `navail` is negative
+// Page allocation fails, and the areas already carved out of pages but
+// the first `navail` are set aside. Areas freed in the meantime are kept.
+void sim_vma_set_nomem(int navail) {
+  static struct Vma *saved;
+  if (sim_nomem) {
+    struct Vma **tail = &vma_free_list;
+    while (*tail) tail = &(*tail)->vma_left;
+    *tail = saved;
+    sim_nomem = false;
+  }
+  if (navail < 0) return;
+  
+  struct Vma *avail = NULL;
+  for (int i = 0; i < navail; i++) {
+    struct Vma *v = vma_alloc();
+    if (!v) panic("sim_vma_set_nomem: out of memory");
+    v->vma_left = avail;
+    avail = v;
+  }
+  saved = vma_free_list;
+  vma_free_list = avail;
+  sim_nomem = true;
+}
+
+int sim_vma_insert(int env, uint32_t start, uint32_t end, int type, int perm,
+    uint32_t file) {
+  struct Env *e = &simenvs[env];
+  if (type == VMA_FILE) {
+    assert(file + (end - start) <= SIM_FILESIZE);
+    return sim_err(vma_insert_file(e, start, end, perm, simfile + file));
+  }
+  return sim_err(vma_insert(e, start, end, type, perm));
+}
+
+int sim_vma_remove(int env, uint32_t start, uint32_t end) {
+  return sim_err(vma_remove(&simenvs[env], start, end));
+}
+
+int sim_vma_copy(int dst, int src) {
+  return sim_err(vma_copy(&simenvs[dst], &simenvs[src]));
+}
+
+void sim_vma_free(int env) {
+  vma_free(&simenvs[env]);
+}
+
+static void sim_vma_export(const struct Vma *v, struct SimVma *out) {
+  out->start = v->vma_start;
+  out->end = v->vma_end;
+  out->type = v->vma_type;
+  out->perm = v->vma_perm;
+  out->file = v->vma_type == VMA_FILE ? v->vma_file - simfile : 0;
+}
+
+// Store the area of `env` containing `va` in *out
+// Returns whether there is one.
+bool sim_vma_lookup(int env, uint32_t va, struct SimVma *out) {
+  struct Vma *v = vma_lookup(&simenvs[env], va);
+  if (v) sim_vma_export(v, out);
+  return v != NULL;
+}
+
+// Check the subtree `v` for order, height and balance, and append its
+// areas to out[*n]
+// Returns its height.
+static int sim_vma_walk(const struct Vma *v, struct SimVma *out, int *n,
+    int max) {
+  if (!v) return 0;
+  int hl = sim_vma_walk(v->vma_left, out, n, max);
+  if (*n > 0) {
+    if (out[*n - 1].end > v->vma_start) panic("areas out of order or overlap");
+  }
+  if (v->vma_start >= v->vma_end) panic("empty area");
+  if (*n == max) panic("more than %d areas", max);
+  sim_vma_export(v, &out[(*n)++]);
+  int hr = sim_vma_walk(v->vma_right, out, n, max);
+  if (v->vma_height != 1 + MAX(hl, hr)) panic("wrong height");
+  if (hl - hr > 1 || hr - hl > 1) panic("tree out of balance");
+  return v->vma_height;
+}
+
+// Store the areas of `env` in address order in out[0..max)
+// Panics if the tree is malformed.
+// Returns the number of areas.
+int sim_vma_list(int env, struct SimVma *out, int max) {
+  struct Env *e = &simenvs[env];
+  int n = 0;
+  sim_vma_walk(e->env_vmas, out, &n, max);
+  if (n != e->env_nvma) panic("env_nvma is %d, not %d", e->env_nvma, n);
+  return n;
+}
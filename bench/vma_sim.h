@@ -0,0 +1,39 @@
+#ifndef BENCH_VMA_SIM_H
+#define BENCH_VMA_SIM_H
+
+// Host-side view of kern/vma.c as built by bench/vma_sim.c
+// Constants mirror kern/vma.h and inc/error.h, which clash with the
+// host's <stdint.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SIM_VMA_ZERO 1
+#define SIM_VMA_FILE 2
+
+#define SIM_E_INVAL 3
+#define SIM_E_NO_MEM 4
+
+// Number of environments, and size of the file VMA_FILE areas map
+#define SIM_NENVS 2
+#define SIM_FILESIZE (1024 * 4096)
+
+// An area as seen by the host
+struct SimVma {
+  uint32_t start;
+  uint32_t end;
+  int type;
+  int perm;
+  uint32_t file; // VMA_FILE: offset of the contents of start
+};
+
+int sim_vma_insert(int env, uint32_t start, uint32_t end, int type, int perm,
+    uint32_t file);
+int sim_vma_remove(int env, uint32_t start, uint32_t end);
+int sim_vma_copy(int dst, int src);
+void sim_vma_free(int env);
+bool sim_vma_lookup(int env, uint32_t va, struct SimVma *out);
+int sim_vma_list(int env, struct SimVma *out, int max);
+void sim_vma_set_nomem(int navail);
+
+#endif // BENCH_VMA_SIM_H
@@ -32,4 +32,12 @@ struct Proghdr {
   uint32_t p_align;
 };
 
+// Values for Proghdr::p_type
+#define ELF_PROG_LOAD 1
+
+// Flag bits for Proghdr::p_flags
+#define ELF_PROG_FLAG_EXEC 1
+#define ELF_PROG_FLAG_WRITE 2
+#define ELF_PROG_FLAG_READ 4
+
 #endif // INC_ELF_H
@@ -17,7 +17,8 @@ enum {
   ENV_DYING,
   ENV_RUNNABLE,
   ENV_RUNNING,
-  ENV_NOT_RUNNABLE
+  ENV_NOT_RUNNABLE,
+  ENV_TEMPLATE // Frozen, only for env_clone
 };
 
 // Special environmemt type
@@ -25,6 +26,8 @@ enum EnvType {
   ENV_TYPE_USER = 0,
 };
 
+struct Vma;
+
 struct Env {
   struct Trapframe env_tf; // Saved registers
   struct Env *env_link; // Next free Env
@@ -34,6 +37,23 @@ struct Env {
   unsigned env_status; // Status of the environment
   uint32_t env_runs; // Number of times environment has run
   pde_t *env_pgdir; // Kernel virtual address of page directory
+  void *env_pgfault_upcall; // Page fault upcall entry point
+  
+  struct Vma *env_vmas; // Tree of virtual memory areas, see kern/vma.c
+  int env_nvma; // Number of virtual memory areas
+  // IPC
+  bool env_ipc_recving; // Env is blocked receiving
+  void *env_ipc_dstva; // VA at which to map received page
+  uint32_t env_ipc_value; // Data value sent to us
+  envid_t env_ipc_from; // envid of the sender
+  int env_ipc_perm; // Perm of page mapping received
+  uintptr_t env_mq; // User address of the message queue, or 0
+  bool env_mq_waiting; // Env is blocked until its queue is not empty
+  
+  uint32_t env_shm; // Open shared memory objects, see kern/shm.c
+  uintptr_t env_sysring; // User address of the system call rings, or 0
+  uint32_t env_pgfaults; // Number of page faults taken
+  uint32_t env_pgfaults_around; // Pages mapped ahead of faults
 };
 
 #endif // INC_ENV_H
@@ -9,6 +9,10 @@ enum {
   E_NO_MEM, // Request failed due to memory shortage
   E_NO_FREE_ENV, // Attemtp to create a new environment beyond the maximum
   E_FAULT, // Memory fault
+  E_IPC_NOT_RECV, // Attempt to send to env that is not recving
+  E_QUEUE_FULL, // Message queue of the receiver is full
+  E_AGAIN, // Value changed before waiting for it
+  E_TIMEOUT, // Wait timed out
   MAXERROR
 };
 
@@ -0,0 +1,95 @@
+// Main public header file for our user-land support library,
+// whose code lives in the lib directory
+// This library is roughly our OS's version of a standard C library,
+// and is intended to be linked into all user-mode applications
+// (NOT the kernel or boot loader)
+#ifndef INC_LIB_H
+#define INC_LIB_H
+
+#include <inc/types.h>
+#include <inc/stdio.h>
+#include <inc/stdarg.h>
+#include <inc/string.h>
+#include <inc/error.h>
+#include <inc/assert.h>
+#include <inc/env.h>
+#include <inc/memlayout.h>
+#include <inc/syscall.h>
+
+#define USED(x) (void)(x)
+
+// main user program
+void umain(int argc, char **argv);
+
+// lib/libmain.c or lib/entry.S
+extern const char *binaryname;
+extern const volatile struct Env *thisenv;
+extern const volatile struct Env envs[NENV];
+extern const volatile struct PageInfo pages[];
+
+// lib/exit.c
+void exit(void);
+
+// lib/syscall.c
+void sys_cputs(const char *string, size_t len);
+int sys_cgetc(void);
+envid_t sys_getenvid(void);
+int sys_env_destroy(envid_t);
+int sys_env_set_template(void);
+envid_t sys_fork(void);
+void sys_yield(void);
+int sys_env_sleep(uint64_t ns);
+int sys_env_set_pgfault_upcall(envid_t env, void *upcall);
+int sys_page_alloc(envid_t env, void *pg, int perm);
+int sys_page_map(envid_t src_env, void *src_pg,
+    envid_t dst_env, void *dst_pg, int perm);
+int sys_page_unmap(envid_t env, void *pg);
+int sys_region_alloc(envid_t env, void *va, size_t len, int perm);
+int sys_region_free(envid_t env, void *va, size_t len);
+int sys_ring_setup(void *va);
+int sys_ring_enter(void);
+int sys_ipc_try_send(envid_t to_env, uint32_t value, void *pg, int perm);
+int sys_ipc_recv(void *rcv_pg, uint32_t timeout_us);
+int sys_ipc_call(envid_t to_env, uint32_t value, void *pg, int perm,
+    void *rcv_pg, uint32_t timeout_us);
+int sys_mq_setup(void *va);
+int sys_mq_send(envid_t to_env, uint32_t value);
+int sys_mq_wait(uint32_t timeout_us);
+int sys_shm_open(const char *name, size_t len);
+int sys_shm_map(int shmid, void *va, int perm);
+int sys_shm_close(int shmid);
+int sys_futex_wait(volatile uint32_t *addr, uint32_t expected,
+    uint32_t timeout_us);
+int sys_futex_wake(volatile uint32_t *addr, int n);
+
+// lib/sbrk.c
+void* sbrk(intptr_t increment);
+
+// lib/ipc.c
+int32_t ipc_recv(envid_t *from_env_store, void *pg, int *perm_store);
+void ipc_send(envid_t to_env, uint32_t value, void *pg, int perm);
+int32_t ipc_call(envid_t to_env, uint32_t value, void *pg, int perm,
+    void *rcv_pg);
+
+// lib/mq.c
+struct MsgQueue* mq_init(void *va);
+bool mq_tryrecv(struct MsgQueue *q, struct Msg *msg);
+void mq_recv(struct MsgQueue *q, struct Msg *msg);
+void mq_send(envid_t to_env, uint32_t value);
+
+// lib/mutex.c
+void mutex_lock(volatile uint32_t *m);
+void mutex_unlock(volatile uint32_t *m);
+void spin_lock(volatile uint32_t *m);
+void spin_unlock(volatile uint32_t *m);
+
+// lib/sysring.c
+struct SysRing* sysring_init(void *va);
+bool sysring_queue(struct SysRing *ring, uint32_t data, uint32_t num,
+    uint32_t a1, uint32_t a2, uint32_t a3, uint32_t a4, uint32_t a5);
+bool sysring_complete(struct SysRing *ring, struct SysCqe *cqe);
+
+// lib/pgfault.c
+void set_pgfault_handler(void (*handler)(struct UTrapframe *utf));
+
+#endif // INC_LIB_H
@@ -22,6 +22,13 @@
 #define IOPHYSMEM 0x0A0000
 #define EXTPHYSMEM 0x100000
 
+// The BIOS loads the boot sector at BOOTSECT
+// Its 64 bytes before the signature, where a partition table would be,
+// hold a NUL-terminated string of space separated boot arguments
+#define BOOTSECT 0x7C00
+#define BOOTARGS (BOOTSECT + 446)
+#define BOOTARGSLEN 64
+
 // Kernel stack
 #define KSTACKTOP KERNBASE
 #define KSTKSIZE (8*PGSIZE) // Size of a kernel stack
@@ -36,10 +43,12 @@
 #define UVPT (ULIM - PTSIZE) // User read-only virtual page table
 #define UPAGES (UVPT - PTSIZE) // Read-only copies of the Page structures
 #define UENVS (UPAGES - PTSIZE) // Read-only copies of the global env structures
+#define USYSCALL (UENVS - PTSIZE) // Read-only page with the system call stub
 
-#define UTOP UENVS // Top of user-accessible virtual memory
+#define UTOP USYSCALL // Top of user-accessible virtual memory
 #define UXSTACKTOP UTOP // Top of one-page user exception stack
 #define USTACKTOP (UTOP - 2*PGSIZE) // Top of normal user stack
+#define USTACKSIZE (256*PGSIZE) // Size the user stack may grow to
 #define UTEXT (2*PTSIZE) // Where user program generally begin
 #define UTEMP ((void*)PTSIZE) // Used for temporally page mappings
 // Used for temporally page mappgins for the user page-fault handler
@@ -53,7 +62,10 @@ typedef uint32_t pde_t;
 
 struct PageInfo {
   struct PageInfo *pp_link; // Next page on the free list
-  uint16_t pp_ref; // Reference counter
+  // Reference counter
+  // User programs add a reference per mapping, so it must count at least
+  // as many mappings as there can be page table entries
+  uint32_t pp_ref;
 };
 
 #endif // __ASSEMBLER__
@@ -35,6 +35,8 @@
 #define PTE_PS 0x80 // Page Size
 #define PTE_G 0x100 // Global
 #define PTE_AVAIL 0xE00 // Avaiable for software use
+#define PTE_COW 0x800 // Copy-on-write, in PTE_AVAIL
+#define PTE_SHARE 0x400 // Stays shared across fork, in PTE_AVAIL
 // PTE_SYSCALL may be used in system calls
 #define PTE_SYSCALL (PTE_AVAIL | PTE_P | PTE_W | PTE_U)
 // Address in page table or page directory entry
@@ -53,4 +55,166 @@
 #define CR0_CD 0x40000000	// Cache Disable
 #define CR0_PG 0x80000000	// Paging
 
+// Eflags register
+#define FL_CF 0x00000001 // Carry Flag
+#define FL_PF 0x00000004 // Parity Flag
+#define FL_AF 0x00000010 // Auxiliary carry Flag
+#define FL_ZF 0x00000040 // Zero Flag
+#define FL_SF 0x00000080 // Sign Flag
+#define FL_TF 0x00000100 // Trap Flag
+#define FL_IF 0x00000200 // Interrupt Flag
+#define FL_DF 0x00000400 // Direction Flag
+#define FL_OF 0x00000800 // Overflow Flag
+#define FL_IOPL_MASK 0x00003000 // I/O Privilege Level bitmask
+#define FL_IOPL_0 0x00000000 //   IOPL == 0
+#define FL_IOPL_3 0x00003000 //   IOPL == 3
+#define FL_NT 0x00004000 // Nested Task
+#define FL_RF 0x00010000 // Resume Flag
+#define FL_VM 0x00020000 // Virtual 8086 mode
+#define FL_AC 0x00040000 // Alignment Check
+#define FL_ID 0x00200000 // ID flag
+
+// Page fault error codes
+#define FEC_PR 0x1 // Page fault caused by protection violation
+#define FEC_WR 0x2 // Page fault caused by a write
+#define FEC_U 0x4 // Page fault occured while in user mode
+
+/**** Segmentation data structures and constants ****/
+
+// Application segment type bits
+#define STA_X 0x8 // Executable segment
+#define STA_E 0x4 // Expand down (non-executable segments)
+#define STA_C 0x4 // Conforming code segment (executable only)
+#define STA_W 0x2 // Writeable (non-executable segments)
+#define STA_R 0x2 // Readable (executable segments)
+#define STA_A 0x1 // Accessed
+
+// System segment type bits
+#define STS_T16A 0x1 // Available 16-bit TSS
+#define STS_LDT 0x2 // Local Descriptor Table
+#define STS_T16B 0x3 // Busy 16-bit TSS
+#define STS_CG16 0x4 // 16-bit Call Gate
+#define STS_TG 0x5 // Task Gate / Coum Transmitions
+#define STS_IG16 0x6 // 16-bit Interrupt Gate
+#define STS_TG16 0x7 // 16-bit Trap Gate
+#define STS_T32A 0x9 // Available 32-bit TSS
+#define STS_T32B 0xB // Busy 32-bit TSS
+#define STS_CG32 0xC // 32-bit Call Gate
+#define STS_IG32 0xE // 32-bit Interrupt Gate
+#define STS_TG32 0xF // 32-bit Trap Gate
+
+#ifndef __ASSEMBLER__
+#include <inc/types.h>
+
+// Segment descriptors
+struct Segdesc {
+  unsigned sd_lim_15_0 : 16; // Low bits of segment limit
+  unsigned sd_base_15_0 : 16; // Low bits of segment base address
+  unsigned sd_base_23_16 : 8; // Middle bits of segment base address
+  unsigned sd_type : 4; // Segment type (see STS_ constants)
+  unsigned sd_s : 1; // 0 = system, 1 = application
+  unsigned sd_dpl : 2; // Descriptor Privilege Level
+  unsigned sd_p : 1; // Present
+  unsigned sd_lim_19_16 : 4; // High bits of segment limit
+  unsigned sd_avl : 1; // Unused (available for software use)
+  unsigned sd_rsv1 : 1; // Reserved
+  unsigned sd_db : 1; // 0 = 16-bit segment, 1 = 32-bit segment
+  unsigned sd_g : 1; // Granularity: limit scaled by 4K when set
+  unsigned sd_base_31_24 : 8; // High bits of segment base address
+};
+// Null segment
+#define SEG_NULL { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }
+// Segment that is loadable but faults when used
+#define SEG_FAULT { 0, 0, 0, 0, 1, 0, 1, 0, 0, 0, 1, 0, 0 }
+// Normal segment
+#define SEG(type, base, lim, dpl) \
+{ ((lim) >> 12) & 0xffff, (base) & 0xffff, ((base) >> 16) & 0xff, \
+  type, 1, dpl, 1, (unsigned) (lim) >> 28, 0, 0, 1, 1, \
+  (unsigned) (base) >> 24 }
+#define SEG16(type, base, lim, dpl) (struct Segdesc) \
+{ (lim) & 0xffff, (base) & 0xffff, ((base) >> 16) & 0xff, \
+  type, 1, dpl, 1, (unsigned) (lim) >> 16, 0, 0, 1, 0, \
+  (unsigned) (base) >> 24 }
+
+// Task state segment format
+struct Taskstate {
+  uint32_t ts_link; // Old ts selector
+  uintptr_t ts_esp0; // Stack pointers and segment selectors
+  uint16_t ts_ss0; //   after an increase in privilege level
+  uint16_t ts_padding1;
+  uintptr_t ts_esp1;
+  uint16_t ts_ss1;
+  uint16_t ts_padding2;
+  uintptr_t ts_esp2;
+  uint16_t ts_ss2;
+  uint16_t ts_padding3;
+  physaddr_t ts_cr3; // Page directory base
+  uintptr_t ts_eip; // Saved state from last task switch
+  uint32_t ts_eflags;
+  uint32_t ts_eax; // More saved state (registers)
+  uint32_t ts_ecx;
+  uint32_t ts_edx;
+  uint32_t ts_ebx;
+  uintptr_t ts_esp;
+  uintptr_t ts_ebp;
+  uint32_t ts_esi;
+  uint32_t ts_edi;
+  uint16_t ts_es; // Even more saved state (segment selectors)
+  uint16_t ts_padding4;
+  uint16_t ts_cs;
+  uint16_t ts_padding5;
+  uint16_t ts_ss;
+  uint16_t ts_padding6;
+  uint16_t ts_ds;
+  uint16_t ts_padding7;
+  uint16_t ts_fs;
+  uint16_t ts_padding8;
+  uint16_t ts_gs;
+  uint16_t ts_padding9;
+  uint16_t ts_ldt;
+  uint16_t ts_padding10;
+  uint16_t ts_t; // Trap on task switch
+  uint16_t ts_iomb; // I/O map base address
+};
+
+// Gate descriptors for interrupts and traps
+struct Gatedesc {
+  unsigned gd_off_15_0 : 16; // Low 16 bits of offset in segment
+  unsigned gd_sel : 16; // Segment selector
+  unsigned gd_args : 5; // # args, 0 for interrupt/trap gates
+  unsigned gd_rsv1 : 3; // Reserved (should be zero I guess)
+  unsigned gd_type : 4; // Type (STS_{TG,IG32,TG32})
+  unsigned gd_s : 1; // Must be 0 (system)
+  unsigned gd_dpl : 2; // Descriptor (meaning new) privilege level
+  unsigned gd_p : 1; // Present
+  unsigned gd_off_31_16 : 16; // High bits of offset in segment
+};
+
+// Set up a normal interrupt/trap gate descriptor
+// `istrap` is 1 for a trap gate, which leaves interrupts enabled,
+// and 0 for an interrupt gate, which disables them on entry
+// `sel` is the code segment selector of the handler
+// `off` is the offset of the handler in the code segment
+// `dpl` is the privilege level required to invoke it with an int instruction
+#define SETGATE(gate, istrap, sel, off, dpl) \
+{ \
+  (gate).gd_off_15_0 = (uint32_t) (off) & 0xffff; \
+  (gate).gd_sel = (sel); \
+  (gate).gd_args = 0; \
+  (gate).gd_rsv1 = 0; \
+  (gate).gd_type = (istrap) ? STS_TG32 : STS_IG32; \
+  (gate).gd_s = 0; \
+  (gate).gd_dpl = (dpl); \
+  (gate).gd_p = 1; \
+  (gate).gd_off_31_16 = (uint32_t) (off) >> 16; \
+}
+
+// Pseudo-descriptors used for LGDT, LLDT and LIDT instructions
+struct Pseudodesc {
+  uint16_t pd_lim; // Limit
+  uint32_t pd_base; // Base address
+} __attribute__ ((packed));
+
+#endif // __ASSEMBLER__
+
 #endif // INC_MMU_H
@@ -10,6 +10,7 @@
 // kern/console.c
 void cputchar(int c);
 int getchar(void);
+int cons_read(char *buf, int n);
 int iscons(int fd);
 
 // kern/printf.c
@@ -0,0 +1,84 @@
+#ifndef INC_SYSCALL_H
+#define INC_SYSCALL_H
+
+#include <inc/types.h>
+#include <inc/env.h>
+
+// System call numbers
+enum {
+  SYS_cputs = 0,
+  SYS_cgetc,
+  SYS_getenvid,
+  SYS_env_destroy,
+  SYS_env_set_template,
+  SYS_fork,
+  SYS_yield,
+  SYS_env_sleep,
+  SYS_env_set_pgfault_upcall,
+  SYS_page_alloc,
+  SYS_page_map,
+  SYS_page_unmap,
+  SYS_region_alloc,
+  SYS_region_free,
+  SYS_ring_setup,
+  SYS_ring_enter,
+  SYS_ipc_try_send,
+  SYS_ipc_recv,
+  SYS_ipc_call,
+  SYS_mq_setup,
+  SYS_mq_send,
+  SYS_mq_wait,
+  SYS_shm_open,
+  SYS_shm_map,
+  SYS_shm_close,
+  SYS_futex_wait,
+  SYS_futex_wake,
+  NSYSCALLS
+};
+
+// Rings of system calls in a page shared by an environment and the
+// kernel, see sys_ring_enter in kern/syscall.c
+#define SYSRING_NSQE 64 // Entries of the submission ring
+#define SYSRING_NCQE 128 // Entries of the completion ring
+
+// A queued system call
+struct SysSqe {
+  uint32_t sqe_num; // System call number
+  uint32_t sqe_args[5];
+  uint32_t sqe_data; // Copied to the completion, to identify it
+};
+
+// The result of a queued system call
+struct SysCqe {
+  int32_t cqe_result;
+  uint32_t cqe_data;
+};
+
+// Indices run freely and wrap around at 2^32, and index i is entry
+// i % size of its ring. The environment advances sq_tail and cq_head,
+// the kernel sq_head and cq_tail.
+struct SysRing {
+  volatile uint32_t sq_head, sq_tail;
+  volatile uint32_t cq_head, cq_tail;
+  struct SysSqe sq[SYSRING_NSQE];
+  struct SysCqe cq[SYSRING_NCQE];
+};
+
+// Queue of asynchronous messages to an environment, in a page it shares
+// with the kernel, see sys_mq_send in kern/syscall.c
+#define MQ_NMSGS 256
+
+struct Msg {
+  envid_t msg_from; // Sender
+  uint32_t msg_value;
+};
+
+// Indices run freely like those of struct SysRing. The kernel advances
+// mq_tail as it queues messages, and the environment mq_head as it
+// takes them.
+struct MsgQueue {
+  volatile uint32_t mq_head, mq_tail;
+  struct Msg mq_msgs[MQ_NMSGS];
+};
+
+#endif // INC_SYSCALL_H
@@ -22,10 +22,34 @@ static inline void outb(int port, uint8_t data) {
   asm volatile("outb %0, %w1" : : "a" (data), "d" (port));
 }
 
+static inline void outw(int port, uint16_t data) {
+  asm volatile("outw %0, %w1" : : "a" (data), "d" (port));
+}
+
+static inline void outl(int port, uint32_t data) {
+  asm volatile("outl %0, %w1" : : "a" (data), "d" (port));
+}
+
 static inline void invlpg(void *addr) {
   asm volatile("invlpg (%0)" : : "r"(addr) : "memory");
 }
 
+static inline void lidt(void *p) {
+  asm volatile("lidt (%0)" : : "r" (p));
+}
+
+static inline void lgdt(void *p) {
+  asm volatile("lgdt (%0)" : : "r" (p));
+}
+
+static inline void lldt(uint16_t sel) {
+  asm volatile("lldt %0" : : "r" (sel));
+}
+
+static inline void ltr(uint16_t sel) {
+  asm volatile("ltr %0" : : "r" (sel));
+}
+
 static inline void lcr0(uint32_t val) {
   asm volatile("movl %0,%%cr0" : : "r" (val));
 }
@@ -36,6 +60,12 @@ static inline uint32_t rcr0(void) {
   return val;
 }
 
+static inline uint32_t rcr2(void) {
+  uint32_t val;
+  asm volatile("movl %%cr2,%0" : "=r" (val));
+  return val;
+}
+
 static inline void lcr3(uint32_t val) {
   asm volatile("movl %0,%%cr3" : : "r" (val));
 }
@@ -46,4 +76,76 @@ static inline uint32_t rcr3(void) {
   return val;
 }
 
+static inline uint32_t read_eflags(void) {
+  uint32_t eflags;
+  asm volatile("pushfl; popl %0" : "=r" (eflags));
+  return eflags;
+}
+
+static inline void write_eflags(uint32_t eflags) {
+  asm volatile("pushl %0; popfl" : : "r" (eflags));
+}
+
+static inline void cpuid(uint32_t info, uint32_t *eaxp, uint32_t *ebxp,
+    uint32_t *ecxp, uint32_t *edxp) {
+  uint32_t eax, ebx, ecx, edx;
+  asm volatile("cpuid"
+    : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx)
+    : "a" (info), "c" (0));
+  if (eaxp) *eaxp = eax;
+  if (ebxp) *ebxp = ebx;
+  if (ecxp) *ecxp = ecx;
+  if (edxp) *edxp = edx;
+}
+
+static inline uint64_t rdmsr(uint32_t msr) {
+  uint32_t lo, hi;
+  asm volatile("rdmsr" : "=a" (lo), "=d" (hi) : "c" (msr));
+  return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t val) {
+  asm volatile("wrmsr" : : "c" (msr), "a" ((uint32_t)val),
+    "d" ((uint32_t)(val >> 32)));
+}
+
+static inline uint64_t read_tsc(void) {
+  uint32_t lo, hi;
+  asm volatile("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t)hi << 32) | lo;
+}
+
+// Unlike rdtsc, rdtscp waits until all previous instructions have executed
+static inline uint64_t read_tscp(void) {
+  uint32_t lo, hi;
+  asm volatile("rdtscp" : "=a" (lo), "=d" (hi) : : "ecx");
+  return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void lfence(void) {
+  asm volatile("lfence" : : : "memory");
+}
+
+// Atomically store `newval` at `addr` and return the old value
+static inline uint32_t xchg(volatile uint32_t *addr, uint32_t newval) {
+  uint32_t result;
+  asm volatile("lock; xchgl %0, %1"
+    : "+m" (*addr), "=a" (result)
+    : "1" (newval)
+    : "cc", "memory");
+  return result;
+}
+
+// Atomically store `newval` at `addr` if it holds `oldval`, and return
+// the value it held
+static inline uint32_t cmpxchg(volatile uint32_t *addr, uint32_t oldval,
+    uint32_t newval) {
+  uint32_t result;
+  asm volatile("lock; cmpxchgl %2, %1"
+    : "=a" (result), "+m" (*addr)
+    : "r" (newval), "0" (oldval)
+    : "cc", "memory");
+  return result;
+}
+
 #endif // INC_X86_H
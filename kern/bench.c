@@ -0,0 +1,197 @@
+#include <kern/bench.h>
+#include <kern/time.h>
+#include <inc/stdio.h>
+#include <inc/stdarg.h>
+#include <inc/string.h>
+#include <inc/x86.h>
+#include <inc/mmu.h>
+
+extern const struct Bench __bench_start[], __bench_end[];
+
+static bool bench_inited;
+static bool has_rdtscp; // CPUID.80000001H:EDX[27]
+static bool has_sse2; // CPUID.01H:EDX[26], required by lfence
+static uint64_t tsc_overhead; // Cycles of an empty measurement
+
+static uint64_t samples[BENCH_MAXSAMPLES];
+
+/**** Timing ****/
+
+// Wait for preceding instructions before reading the TSC
+static inline uint64_t tsc_begin(void) {
+  if (has_sse2) lfence();
+  return read_tsc();
+}
+
+// Wait for the measured instructions, and
+// keep following instructions from starting before reading the TSC
+static inline uint64_t tsc_end(void) {
+  uint64_t tsc;
+  if (has_rdtscp) {
+    tsc = read_tscp();
+  } else {
+    if (has_sse2) lfence();
+    tsc = read_tsc();
+  }
+  if (has_sse2) lfence();
+  return tsc;
+}
+
+static void sort(uint64_t *a, int n) {
+  // Shell sort with gaps of the form (3^k - 1) / 2
+  int gap = 1;
+  while (gap < n / 3) gap = gap * 3 + 1;
+  for (; gap > 0; gap /= 3) {
+    for (int i = gap; i < n; i++) {
+      uint64_t v = a[i];
+      int j;
+      for (j = i; j >= gap && a[j - gap] > v; j -= gap) a[j] = a[j - gap];
+      a[j] = v;
+    }
+  }
+}
+
+static void measure(void (*func)(void), int n) {
+  for (int i = 0; i < n; i++) {
+    uint64_t start = tsc_begin();
+    func();
+    samples[i] = tsc_end() - start;
+  }
+  sort(samples, n);
+}
+
+static void bench_nop(void) {}
+
+static void bench_init(void) {
+  uint32_t eax, edx;
+  cpuid(1, NULL, NULL, NULL, &edx);
+  has_sse2 = (edx >> 26) & 1;
+  cpuid(0x80000000, &eax, NULL, NULL, NULL);
+  if (eax >= 0x80000001) {
+    cpuid(0x80000001, NULL, NULL, NULL, &edx);
+    has_rdtscp = (edx >> 27) & 1;
+  }
+  
+  // The cheapest empty measurement is the overhead of timing itself
+  measure(bench_nop, BENCH_NSAMPLES);
+  tsc_overhead = samples[0];
+  bench_inited = true;
+}
+
+/**** Benchmark registry ****/
+
+const struct Bench* bench_lookup(const char *name) {
+  for (const struct Bench *b = __bench_start; b < __bench_end; b++) {
+    if (strcmp(b->name, name) == 0) return b;
+  }
+  return NULL;
+}
+
+void bench_run(const struct Bench *b, struct BenchResult *res) {
+  if (!bench_inited) bench_init();
+  
+  int n = b->nsamples ? b->nsamples : BENCH_NSAMPLES;
+  if (n > BENCH_MAXSAMPLES) n = BENCH_MAXSAMPLES;
+  
+  if (b->setup) b->setup();
+  // Warm up caches and TLBs once before measuring
+  b->func();
+  measure(b->func, n);
+  if (b->teardown) b->teardown();
+  
+  for (int i = 0; i < n; i++) {
+    samples[i] = samples[i] > tsc_overhead ? samples[i] - tsc_overhead : 0;
+  }
+  res->nsamples = n;
+  res->min = samples[0];
+  res->median = samples[n / 2];
+  res->p99 = samples[(n * 99 + 99) / 100 - 1];
+  res->max = samples[n - 1];
+}
+
+int bench_run_all(const char *prefix) {
+  struct BenchResult res;
+  int nrun = 0;
+  
+  cprintf("%-28s %6s %10s %10s %10s\n",
+      "benchmark (cycles)", "n", "min", "median", "p99");
+  for (const struct Bench *b = __bench_start; b < __bench_end; b++) {
+    if (prefix && strncmp(b->name, prefix, strlen(prefix)) != 0) continue;
+    bench_run(b, &res);
+    cprintf("%-28s %6d %10llu %10llu %10llu\n",
+        b->name, res.nsamples, res.min, res.median, res.p99);
+    nrun++;
+  }
+  return nrun;
+}
+
+/**** Automated runs under QEMU ****/
+
+// QEMU's -debugcon writes bytes sent to this port to a file
+#define DEBUGCON_PORT 0xE9
+// QEMU's isa-debug-exit device exits with status (value << 1) | 1
+#define DEBUG_EXIT_PORT 0xF4
+
+static void debugcon_putch(int ch, void *arg) {
+  outb(DEBUGCON_PORT, ch);
+}
+
+static void dcprintf(const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  vprintfmt(debugcon_putch, NULL, fmt, ap);
+  va_end(ap);
+}
+
+// Return true if `name` starts with one of comma separated `prefixes`
+static bool bench_selected(const char *name, const char *prefixes) {
+  if (strcmp(prefixes, "all") == 0) return true;
+  while (*prefixes) {
+    int len = strfind(prefixes, ',') - prefixes;
+    if (len > 0 && strncmp(name, prefixes, len) == 0) return true;
+    prefixes += len;
+    if (*prefixes == ',') prefixes++;
+  }
+  return false;
+}
+
+void bench_boot(const char *suite) {
+  struct BenchResult res;
+  int nrun = 0;
+  
+  cprintf("Running benchmarks '%s'\n", suite);
+  for (const struct Bench *b = __bench_start; b < __bench_end; b++) {
+    if (!bench_selected(b->name, suite)) continue;
+    bench_run(b, &res);
+    cprintf("%-28s %10llu cycles\n", b->name, res.median);
+    dcprintf("{\"name\": \"%s\", \"unit\": \"cycles\", \"n\": %d, "
+        "\"min\": %llu, \"median\": %llu, \"p99\": %llu, \"max\": %llu}\n",
+        b->name, res.nsamples, res.min, res.median, res.p99, res.max);
+    nrun++;
+  }
+  dcprintf("{\"done\": true, \"suite\": \"%s\", \"count\": %d, "
+      "\"tsc_hz\": %llu}\n", suite, nrun, timeinfo.tsc_hz);
+  
+  // Only returns if QEMU has no isa-debug-exit device
+  outl(DEBUG_EXIT_PORT, nrun > 0 ? 0 : 1);
+}
+
+/**** Benchmarks of lib/ and the console ****/
+
+static char bench_src[PGSIZE], bench_dst[PGSIZE];
+
+static void bench_memset(void) {
+  memset(bench_dst, 0, PGSIZE);
+}
+BENCH(memset, "memset/4KiB", NULL, bench_memset, NULL, 0);
+
+static void bench_memmove(void) {
+  memmove(bench_dst, bench_src, PGSIZE);
+}
+BENCH(memmove, "memmove/4KiB", NULL, bench_memmove, NULL, 0);
+
+static void bench_cprintf(void) {
+  cprintf("bench: the quick brown fox jumps over the lazy dog %08x\n",
+      0xdeadbeef);
+}
+BENCH(cprintf, "cprintf/line", NULL, bench_cprintf, NULL, 64);
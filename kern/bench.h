@@ -0,0 +1,50 @@
+#ifndef KERN_BENCH_H
+#define KERN_BENCH_H
+
+#include <inc/types.h>
+
+// A kernel microbenchmark
+// `func` performs the measured operation once and is timed `nsamples` times
+// `setup` and `teardown` are called before and after all samples if not NULL
+struct Bench {
+  const char *name;
+  void (*setup)(void);
+  void (*func)(void);
+  void (*teardown)(void);
+  int nsamples; // 0 means BENCH_NSAMPLES
+};
+
+#define BENCH_NSAMPLES 1000
+#define BENCH_MAXSAMPLES 4096
+
+// Statistics in TSC cycles, with the timing overhead subtracted
+struct BenchResult {
+  int nsamples;
+  uint64_t min;
+  uint64_t median;
+  uint64_t p99;
+  uint64_t max;
+};
+
+// Register a benchmark in the .bench section
+// kern/kernel.ld collects them between __bench_start and __bench_end
+#define BENCH(ident, _name, _setup, _func, _teardown, _nsamples) \
+  static const struct Bench bench_entry_##ident \
+  __attribute__((__used__, __section__(".bench"), __aligned__(4))) = { \
+    .name = _name, \
+    .setup = _setup, \
+    .func = _func, \
+    .teardown = _teardown, \
+    .nsamples = _nsamples, \
+  }
+
+const struct Bench* bench_lookup(const char *name);
+void bench_run(const struct Bench *b, struct BenchResult *res);
+// Run every benchmark whose name starts with `prefix` and print the results
+int bench_run_all(const char *prefix);
+// Run benchmarks whose names start with one of comma separated prefixes
+// in `suite`, or all of them for "all", report them as JSON lines on
+// QEMU's debug console, and exit QEMU
+void bench_boot(const char *suite);
+
+#endif // KERN_BENCH_H
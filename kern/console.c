@@ -3,9 +3,101 @@
 #include <inc/memlayout.h>
 #include <inc/kbdreg.h>
 #include <inc/string.h>
+#include <inc/assert.h>
+#include <inc/stdio.h>
+#include <inc/trap.h>
+#include <kern/trap.h>
+#include <kern/picirq.h>
+#include <kern/time.h>
 
 static void cons_intr(int (*proc)(void));
 
+// Stupid I/O delay routine necessitated by historical PC design flaws
+static void delay(void) {
+  inb(0x84);
+  inb(0x84);
+  inb(0x84);
+  inb(0x84);
+}
+
+/**** Serial I/O code ****/
+
+#define COM1 0x3F8
+
+#define COM_RX 0 // In:  Receive buffer (DLAB=0)
+#define COM_TX 0 // Out: Transmit buffer (DLAB=0)
+#define COM_DLL 0 // Out: Divisor Latch Low (DLAB=1)
+#define COM_DLM 1 // Out: Divisor Latch High (DLAB=1)
+#define COM_IER 1 // Out: Interrupt Enable Register
+#define   COM_IER_RDI 0x01 //   Enable receiver data interrupt
+#define COM_IIR 2 // In:  Interrupt ID Register
+#define COM_FCR 2 // Out: FIFO Control Register
+#define COM_LCR 3 // Out: Line Control Register
+#define   COM_LCR_DLAB 0x80 //   Divisor latch access bit
+#define   COM_LCR_WLEN8 0x03 //   Wordlength: 8 bits
+#define COM_MCR 4 // Out: Modem Control Register
+#define   COM_MCR_RTS 0x02 // RTS complement
+#define   COM_MCR_DTR 0x01 // DTR complement
+#define   COM_MCR_OUT2 0x08 // Out2 complement
+#define COM_LSR 5 // In:  Line Status Register
+#define   COM_LSR_DATA 0x01 //   Data available
+#define   COM_LSR_TXRDY 0x20 //   Transmit buffer avail
+#define   COM_LSR_TSRE 0x40 //   Transmitter off
+
+static bool serial_exists;
+
+static int serial_proc_data(void) {
+  if (!(inb(COM1+COM_LSR) & COM_LSR_DATA)) return -1;
+  return inb(COM1+COM_RX);
+}
+
+// Read all characters that were not yet read into the console buffer
+void serial_intr(void) {
+  if (serial_exists) cons_intr(serial_proc_data);
+}
+
+static void serial_irq(struct Trapframe *tf) {
+  serial_intr();
+  irq_eoi(IRQ_SERIAL);
+}
+
+static void serial_putc(int c) {
+  for (int i = 0; !(inb(COM1 + COM_LSR) & COM_LSR_TXRDY) && i < 12800; i++) {
+    delay();
+  }
+  outb(COM1 + COM_TX, c);
+}
+
+static void serial_init(void) {
+  // Turn off the FIFO
+  outb(COM1+COM_FCR, 0);
+  
+  // Set speed; requires DLAB latch
+  outb(COM1+COM_LCR, COM_LCR_DLAB);
+  outb(COM1+COM_DLL, (uint8_t) (115200 / 9600));
+  outb(COM1+COM_DLM, 0);
+  
+  // 8 data bits, 1 stop bit, parity off; turn off DLAB latch
+  outb(COM1+COM_LCR, COM_LCR_WLEN8 & ~COM_LCR_DLAB);
+  
+  // No modem controls
+  // OUT2 gates the UART's interrupt line to the PIC
+  outb(COM1+COM_MCR, COM_MCR_OUT2);
+  // Enable rcv interrupts
+  outb(COM1+COM_IER, COM_IER_RDI);
+  
+  // Clear any preexisting overrun indications and interrupts
+  // Serial port doesn't exist if COM_LSR returns 0xFF
+  serial_exists = (inb(COM1+COM_LSR) != 0xFF);
+  (void) inb(COM1+COM_IIR);
+  (void) inb(COM1+COM_RX);
+  
+  if (serial_exists) {
+    trap_register(IRQ_OFFSET + IRQ_SERIAL, serial_irq);
+    irq_enable(IRQ_SERIAL);
+  }
+}
+
 /**** Text-mode VGA display output ****/
 
 static uint16_t* crt_buf;
@@ -233,52 +325,115 @@ void kbd_intr(void) {
   cons_intr(kbd_proc_data);
 }
 
-static void kbd_init(void) {}
+static void kbd_irq(struct Trapframe *tf) {
+  kbd_intr();
+  irq_eoi(IRQ_KBD);
+}
+
+static void kbd_init(void) {
+  // Drain the kbd buffer so that QEMU generates interrupts
+  kbd_intr();
+  trap_register(IRQ_OFFSET + IRQ_KBD, kbd_irq);
+  irq_enable(IRQ_KBD);
+}
 
 /**** General device-indepdent console code ****/
 
-#define CONSBUFSIZE 512
+// Console input ring
+// The device interrupt handlers (or pollers) are the only producer and
+// cons_read the only consumer. Producers run with interrupts disabled,
+// so they never interleave with each other.
+// The indices increase monotonically and are reduced modulo CONSBUFSIZE
+// only to address `buf`, so wpos - rpos is the number of unread bytes
+// even after they wrap around.
+#define CONSBUFSIZE 512 // Must be a power of two
 static struct {
   uint8_t buf[CONSBUFSIZE];
-  uint32_t rpos; // Read position
-  uint32_t wpos; // Write position
+  uint32_t rpos; // Read position, written only by the consumer
+  uint32_t wpos; // Write position, written only by the producer
+  uint32_t dropped; // Characters lost because the ring was full
 } cons;
 
 // Store input data read by `proc` to the console buffer `buf`
-// `buf` is a circular buffer that stores the maximum of CONSBUFSIZE bytes.
+// Characters that do not fit are dropped rather than
+// overwriting unread input.
 void cons_intr(int (*proc)(void)) {
   int c;
+  uint32_t wpos = cons.wpos;
   while ((c=(*proc)()) != -1) {
     if (c == 0) continue;
-    cons.buf[cons.wpos++] = c;
-    if (cons.wpos == CONSBUFSIZE) cons.wpos = 0;
+    if (wpos - __atomic_load_n(&cons.rpos, __ATOMIC_ACQUIRE) == CONSBUFSIZE) {
+      cons.dropped++;
+      continue;
+    }
+    cons.buf[wpos++ & (CONSBUFSIZE-1)] = c;
+    // Publish the character only after it is stored
+    __atomic_store_n(&cons.wpos, wpos, __ATOMIC_RELEASE);
+  }
+}
+
+// Copy at most n characters from the console buffer to `buf`
+// without waiting, and return the number of characters copied
+static int cons_drain(char *buf, int n) {
+  static_assert((CONSBUFSIZE & (CONSBUFSIZE-1)) == 0);
+  uint32_t rpos = cons.rpos;
+  uint32_t avail = __atomic_load_n(&cons.wpos, __ATOMIC_ACQUIRE) - rpos;
+  int i;
+  for (i = 0; i < n && i < avail; i++) {
+    buf[i] = cons.buf[rpos++ & (CONSBUFSIZE-1)];
   }
+  // Hand the slots back to the producer only after they are read
+  __atomic_store_n(&cons.rpos, rpos, __ATOMIC_RELEASE);
+  return i;
+}
+
+// Return the number of input characters dropped because the buffer was full
+uint32_t cons_dropped(void) {
+  return __atomic_load_n(&cons.dropped, __ATOMIC_RELAXED);
 }
 
 // Initialize the console devices
 void cons_init(void) {
   cga_init();
   kbd_init();
+  serial_init();
+  
+  if (!serial_exists) cprintf("Serial port does not exist!\n");
 }
 
 // Output a character to the console
 void cons_putc(int c) {
+  serial_putc(c);
   cga_putc(c);
 }
 
 // Read all characters that were not read yet to the console buffer
 // and returns the first one character from the buffer.
+// Devices are polled as well, so that this works
+// even before interrupts are set up, e.g. in an early panic
 int cons_getc(void) {
+  serial_intr();
   kbd_intr();
-  int c;
-  if (cons.rpos != cons.wpos) {
-    c = cons.buf[cons.rpos++];
-    if (cons.rpos == CONSBUFSIZE) cons.rpos = 0;
-    return c;
-  }
+  char c;
+  if (cons_drain(&c, 1) == 1) return (uint8_t) c;
   return 0;
 }
 
+// Read at most n characters from the console into `buf`,
+// waiting until at least one character is available.
+// Returns the number of characters read.
+int cons_read(char *buf, int n) {
+  int r;
+  if (n <= 0) return 0;
+  while (1) {
+    serial_intr();
+    kbd_intr();
+    if ((r = cons_drain(buf, n)) > 0) return r;
+    // Sleep until the keyboard or serial port interrupts
+    if (pic_ready) cpu_idle();
+  }
+}
+
 /**** High level console IO ****/
 
 void cputchar(int c) {
@@ -286,9 +441,9 @@ void cputchar(int c) {
 }
 
 int getchar(void) {
-  int c;
-  while((c=cons_getc()) == 0);
-  return c;
+  char c;
+  cons_read(&c, 1);
+  return (uint8_t) c;
 }
 
 int iscons(int fdnum) {
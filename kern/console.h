@@ -1,6 +1,8 @@
 #ifndef KERN_CONSOLE_H
 #define KERN_CONSOLE_H
 
+#include <inc/types.h>
+
 #define CGA_BASE 0x3D4
 #define CGA_BUF 0xB8000
 #define CRT_ROWS 25
@@ -10,5 +12,8 @@
 void cons_init(void);
 void cons_putc(int c);
 int cons_getc(void);
+uint32_t cons_dropped(void);
+void kbd_intr(void);
+void serial_intr(void);
 
 #endif // KERN_CONSOLE_H
@@ -0,0 +1,23 @@
+#ifndef KERN_CPU_H
+#define KERN_CPU_H
+
+#include <inc/types.h>
+
+// Maximum number of CPUs
+#define NCPU 8
+
+// Per-CPU state
+struct CpuInfo {
+  uint8_t cpu_id; // Local APIC ID; index into cpus[] below
+  uint64_t timer_irqs; // Timer interrupts taken
+  uint64_t idle_entries; // Times the CPU halted in cpu_idle
+  uint64_t idle_cycles; // TSC cycles spent halted in cpu_idle
+};
+
+extern struct CpuInfo cpus[NCPU];
+extern int ncpu; // Total number of CPUs in the system
+
+int cpunum(void);
+#define thiscpu (&cpus[cpunum()])
+
+#endif // KERN_CPU_H
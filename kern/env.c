@@ -1,5 +1,740 @@
 #include <kern/env.h>
+#include <inc/mmu.h>
+#include <inc/x86.h>
+#include <inc/error.h>
+#include <inc/string.h>
+#include <inc/elf.h>
+#include <kern/pmap.h>
+#include <kern/vma.h>
+#include <kern/shm.h>
+#include <kern/futex.h>
+#include <kern/trap.h>
+#include <kern/sched.h>
+#include <kern/bench.h>
 
-struct Env *envs = NULL;
-struct Env *curenv = NULL;
+struct Env *envs = NULL; // All environments
+struct Env *curenv = NULL; // The current env
+static struct Env *env_free_list; // Free environment list
 
+// User programs embedded in the kernel image by user/Makefrag
+// kern/kernel.ld starts each of them on a new page
+extern uint8_t __userprogs_start[], __userprogs_end[];
+extern uint8_t _binary_build_user_hello_start[];
+extern uint8_t _binary_build_user_null_start[];
+extern uint8_t _binary_build_user_zygote_start[];
+extern uint8_t _binary_build_user_fork_start[];
+extern uint8_t _binary_build_user_faultalloc_start[];
+extern uint8_t _binary_build_user_lazyheap_start[];
+extern uint8_t _binary_build_user_sysbench_start[];
+extern uint8_t _binary_build_user_pagemap_start[];
+extern uint8_t _binary_build_user_pagemapring_start[];
+extern uint8_t _binary_build_user_ipcbench_start[];
+extern uint8_t _binary_build_user_mqbench_start[];
+extern uint8_t _binary_build_user_shmpipe_start[];
+extern uint8_t _binary_build_user_futexbench_start[];
+extern uint8_t _binary_build_user_sleep_start[];
+
+#define USERPROG(x) { #x, _binary_build_user_##x##_start }
+static const struct {
+  const char *name;
+  const uint8_t *binary;
+} userprogs[] = {
+  USERPROG(hello),
+  USERPROG(null),
+  USERPROG(zygote),
+  USERPROG(fork),
+  USERPROG(faultalloc),
+  USERPROG(lazyheap),
+  USERPROG(sysbench),
+  USERPROG(pagemap),
+  USERPROG(pagemapring),
+  USERPROG(ipcbench),
+  USERPROG(mqbench),
+  USERPROG(shmpipe),
+  USERPROG(futexbench),
+  USERPROG(sleep),
+};
+
+// The bits of an envid above ENVGENSHIFT are a generation number
+// incremented every time the Env slot is reused, so that ids of
+// freed environments are told apart from the current one
+#define ENVGENSHIFT 12 // >= LOG2NENV
+
+// Global descriptor table
+// Kernel and user segments are identical except for the DPL
+// The TSS descriptor is filled in by trap_init_percpu
+struct Segdesc gdt[] = {
+  // 0x0 - unused (always faults)
+  SEG_NULL,
+  // 0x8 - kernel code segment
+  [GD_KT >> 3] = SEG(STA_X | STA_R, 0x0, 0xffffffff, 0),
+  // 0x10 - kernel data segment
+  [GD_KD >> 3] = SEG(STA_W, 0x0, 0xffffffff, 0),
+  // 0x18 - user code segment
+  [GD_UT >> 3] = SEG(STA_X | STA_R, 0x0, 0xffffffff, 3),
+  // 0x20 - user data segment
+  [GD_UD >> 3] = SEG(STA_W, 0x0, 0xffffffff, 3),
+  // 0x28 - tss, initialized in trap_init_percpu()
+  [GD_TSS0 >> 3] = SEG_NULL
+};
+
+struct Pseudodesc gdt_pd = {
+  sizeof(gdt) - 1, (unsigned long) gdt
+};
+
+// Load the GDT and segment registers
+// The GDT of the boot loader lives in a page that is reused after boot
+void env_init_percpu(void) {
+  lgdt(&gdt_pd);
+  // The kernel never uses GS or FS, so we leave those set to the user data segment
+  asm volatile("movw %%ax,%%gs" : : "a" (GD_UD|3));
+  asm volatile("movw %%ax,%%fs" : : "a" (GD_UD|3));
+  // The kernel does use ES, DS, and SS
+  // We'll change between the kernel and user data segments as needed
+  asm volatile("movw %%ax,%%es" : : "a" (GD_KD));
+  asm volatile("movw %%ax,%%ds" : : "a" (GD_KD));
+  asm volatile("movw %%ax,%%ss" : : "a" (GD_KD));
+  // Load the kernel text segment into CS
+  asm volatile("ljmp %0,$1f\n 1:\n" : : "i" (GD_KT));
+  // For good measure, clear the local descriptor table (LDT),
+  // since we don't use it
+  lldt(0);
+}
+
+/**** Environment lifecycle ****/
+
+// Convert an envid to an env pointer
+// If checkperm is set, the specified environment must be either the
+// current environment or an immediate child of the current environment.
+// Returns 0 on success, -E_BAD_ENV on error.
+int envid2env(envid_t envid, struct Env **env_store, bool checkperm) {
+  // envid 0 means the current environment
+  if (envid == 0) {
+    *env_store = curenv;
+    return curenv ? 0 : -E_BAD_ENV;
+  }
+  
+  // The slot is found directly by ENVX; a stale envid of an earlier
+  // occupant of the slot has a different generation
+  struct Env *e = &envs[ENVX(envid)];
+  if (e->env_status == ENV_FREE || e->env_id != envid) {
+    *env_store = NULL;
+    return -E_BAD_ENV;
+  }
+  if (checkperm && e != curenv &&
+      (!curenv || e->env_parent_id != curenv->env_id)) {
+    *env_store = NULL;
+    return -E_BAD_ENV;
+  }
+  *env_store = e;
+  return 0;
+}
+
+// Mark all environments in `envs` as free and insert them into
+// the env_free_list, so that the first call to env_alloc returns envs[0]
+void env_init(void) {
+  for (int i = NENV - 1; i >= 0; i--) {
+    envs[i].env_id = 0;
+    envs[i].env_status = ENV_FREE;
+    envs[i].env_link = env_free_list;
+    env_free_list = &envs[i];
+  }
+  
+  // load_icode maps pages of the embedded programs into environments
+  // Hold a reference to them, so that they are not put on the free list
+  // when the last environment mapping them is freed
+  for (uint8_t *p = ROUNDDOWN((uint8_t*)__userprogs_start, PGSIZE);
+      p < __userprogs_end; p += PGSIZE) {
+    pa2page(PADDR(p))->pp_ref++;
+  }
+  
+  env_init_percpu();
+}
+
+// Allocate a page directory for `e`
+// The user part below UTOP starts out empty. The kernel part is the
+// same in every address space, so it is copied from kern_pgdir as one
+// range of PDEs; the page tables themselves are shared.
+static int env_setup_vm(struct Env *e) {
+  struct PageInfo *p = page_alloc(0);
+  if (!p) return -E_NO_MEM;
+  p->pp_ref++;
+  e->env_pgdir = page2kva(p);
+  memset(e->env_pgdir, 0, PDX(UTOP) * sizeof(pde_t));
+  memcpy(e->env_pgdir + PDX(UTOP), kern_pgdir + PDX(UTOP),
+      (NPDENTRIES - PDX(UTOP)) * sizeof(pde_t));
+  
+  // UVPT maps the env's own page table read-only
+  e->env_pgdir[PDX(UVPT)] = PADDR(e->env_pgdir) | PTE_P | PTE_U;
+  return 0;
+}
+
+// Allocate and initialize a new environment
+// On success, the new environment is stored in *newenv_store.
+// Returns 0 on success, < 0 on failure. Errors include:
+//   -E_NO_FREE_ENV if all NENV environments are allocated
+//   -E_NO_MEM on memory exhaustion
+int env_alloc(struct Env **newenv_store, envid_t parent_id) {
+  struct Env *e = env_free_list;
+  if (!e) return -E_NO_FREE_ENV;
+  
+  int r = env_setup_vm(e);
+  if (r < 0) return r;
+  
+  // Generate an env_id for this environment
+  int32_t generation = (e->env_id + (1 << ENVGENSHIFT)) & ~(NENV - 1);
+  if (generation <= 0) generation = 1 << ENVGENSHIFT; // Don't create a negative env_id
+  e->env_id = generation | (e - envs);
+  
+  e->env_parent_id = parent_id;
+  e->env_type = ENV_TYPE_USER;
+  e->env_status = ENV_RUNNABLE;
+  e->env_runs = 0;
+  e->env_pgfault_upcall = NULL;
+  e->env_vmas = NULL;
+  e->env_nvma = 0;
+  e->env_ipc_recving = false;
+  e->env_mq = 0;
+  e->env_mq_waiting = false;
+  e->env_shm = 0;
+  e->env_sysring = 0;
+  e->env_pgfaults = 0;
+  e->env_pgfaults_around = 0;
+  
+  // Set up the segment registers with the user segments and RPL 3
+  // The stack pointer and entry point are set by the loader
+  memset(&e->env_tf, 0, sizeof(e->env_tf));
+  e->env_tf.tf_ds = GD_UD | 3;
+  e->env_tf.tf_es = GD_UD | 3;
+  e->env_tf.tf_ss = GD_UD | 3;
+  e->env_tf.tf_esp = USTACKTOP;
+  e->env_tf.tf_cs = GD_UT | 3;
+  // Enable interrupts while in user mode
+  e->env_tf.tf_eflags = FL_IF;
+  
+  env_free_list = e->env_link;
+  e->env_link = NULL;
+  *newenv_store = e;
+  return 0;
+}
+
+// Free env `e` and all memory it uses
+void env_free(struct Env *e) {
+  // Switch to kern_pgdir before freeing the page directory in use
+  // The switch also flushes the TLB, so the user mappings are dropped
+  // below without invalidating them one by one
+  if (e == curenv) lcr3(PADDR(kern_pgdir));
+  
+  for (int pdeno = 0; pdeno < PDX(UTOP); pdeno++) {
+    if (!(e->env_pgdir[pdeno] & PTE_P)) continue;
+    physaddr_t pa = PTE_ADDR(e->env_pgdir[pdeno]);
+    e->env_pgdir[pdeno] = 0;
+    // The pages mapped by a page table shared with other environments
+    // are released by the last of them
+    if (pa2page(pa)->pp_ref == 1) {
+      pte_t *pt = KADDR(pa);
+      for (int pteno = 0; pteno < NPTENTRIES; pteno++) {
+        if (pt[pteno] & PTE_P) page_decref(pa2page(PTE_ADDR(pt[pteno])));
+      }
+    }
+    page_decref(pa2page(pa));
+  }
+  
+  vma_free(e);
+  shm_free(e);
+  futex_cancel(e);
+  sched_free(e);
+  physaddr_t pa = PADDR(e->env_pgdir);
+  e->env_pgdir = NULL;
+  page_decref(pa2page(pa));
+  
+  // Return the environment to the free list
+  e->env_status = ENV_FREE;
+  e->env_link = env_free_list;
+  env_free_list = e;
+}
+
+// Free env `e`
+// If `e` is the current environment, another one is scheduled.
+void env_destroy(struct Env *e) {
+  env_free(e);
+  if (e == curenv) {
+    curenv = NULL;
+    sched_yield();
+  }
+}
+
+/**** Copy-on-write address spaces ****/
+
+// Make the writable pages of `pgdir` below UTOP copy-on-write, except
+// for those marked PTE_SHARE
+// A page table shared with other environments has no writable entries
+// but shared ones, so is left as it is.
+static void pgdir_mark_cow(pde_t *pgdir) {
+  for (int pdeno = 0; pdeno < PDX(UTOP); pdeno++) {
+    if (!(pgdir[pdeno] & PTE_P)) continue;
+    pte_t *pt = KADDR(PTE_ADDR(pgdir[pdeno]));
+    for (int pteno = 0; pteno < NPTENTRIES; pteno++) {
+      if ((pt[pteno] & (PTE_W | PTE_SHARE)) == PTE_W) {
+        pt[pteno] = (pt[pteno] & ~PTE_W) | PTE_COW;
+      }
+    }
+  }
+}
+
+// Point the empty user part of `dst` to the page tables of `src`
+// Only the PDEs are copied: the page tables are shared until either
+// side changes a mapping in them.
+static void pgdir_share(pde_t *dst, pde_t *src) {
+  for (int pdeno = 0; pdeno < PDX(UTOP); pdeno++) {
+    if (!(src[pdeno] & PTE_P)) continue;
+    pa2page(PTE_ADDR(src[pdeno]))->pp_ref++;
+    dst[pdeno] = src[pdeno];
+  }
+}
+
+// Give the new environment `e` everything of `src` but its address
+// space: areas, registers, upcall, rings, queue and shared memory
+// Per-environment state that children inherit is copied here only.
+// Returns 0 on success, or -E_NO_MEM
+static int env_inherit(struct Env *e, struct Env *src) {
+  int r = vma_copy(e, src);
+  if (r < 0) return r;
+  e->env_tf = src->env_tf;
+  e->env_type = src->env_type;
+  e->env_pgfault_upcall = src->env_pgfault_upcall;
+  e->env_sysring = src->env_sysring;
+  e->env_mq = src->env_mq;
+  shm_copy(e, src);
+  return 0;
+}
+
+// Allocate a child of `parent` with a copy-on-write copy of its
+// address space, registers and page fault upcall
+// The child returns 0 from the system call that forked it.
+// Returns 0 on success, < 0 on failure. Errors include:
+//   -E_NO_FREE_ENV if all NENV environments are allocated
+//   -E_NO_MEM on memory exhaustion
+int env_fork(struct Env **newenv_store, struct Env *parent) {
+  struct Env *e;
+  int r = env_alloc(&e, parent->env_id);
+  if (r < 0) return r;
+  if ((r = env_inherit(e, parent)) < 0) {
+    env_free(e);
+    return r;
+  }
+  
+  pgdir_mark_cow(parent->env_pgdir);
+  // Flush the writable mappings from the TLB
+  if (rcr3() == PADDR(parent->env_pgdir)) lcr3(PADDR(parent->env_pgdir));
+  pgdir_share(e->env_pgdir, parent->env_pgdir);
+  
+  e->env_tf.tf_regs.reg_eax = 0;
+  *newenv_store = e;
+  return 0;
+}
+
+// Freeze `e` as a template for env_clone
+// Its writable pages become copy-on-write, after which clones share
+// its page tables, and it never runs again. Clones start from its
+// saved registers with a return value of 0 in %eax, as if returning
+// from the system call that made `e` a template.
+void env_make_template(struct Env *e) {
+  pgdir_mark_cow(e->env_pgdir);
+  e->env_tf.tf_regs.reg_eax = 0;
+  e->env_status = ENV_TEMPLATE;
+  
+  if (e == curenv) {
+    // Flush the writable mappings from the TLB
+    lcr3(PADDR(kern_pgdir));
+    curenv = NULL;
+    sched_yield();
+  }
+}
+
+// Allocate a new environment with a copy-on-write copy of the address
+// space and registers of the template `tmpl`
+// The clone shares the page tables of the template until it writes to
+// them. The parent of the clone is the parent of the template.
+// Returns 0 on success, < 0 on failure. Errors include:
+//   -E_INVAL if tmpl is not a template
+//   -E_NO_FREE_ENV if all NENV environments are allocated
+//   -E_NO_MEM on memory exhaustion
+int env_clone(struct Env **newenv_store, struct Env *tmpl) {
+  if (tmpl->env_status != ENV_TEMPLATE) return -E_INVAL;
+  struct Env *e;
+  int r = env_alloc(&e, tmpl->env_parent_id);
+  if (r < 0) return r;
+  if ((r = env_inherit(e, tmpl)) < 0) {
+    env_free(e);
+    return r;
+  }
+  
+  pgdir_share(e->env_pgdir, tmpl->env_pgdir);
+  *newenv_store = e;
+  return 0;
+}
+
+/**** Loading user programs ****/
+
+// Return the embedded user program called `name`, or NULL
+const uint8_t* userprog_lookup(const char *name) {
+  for (int i = 0; i < ARRAY_SIZE(userprogs); i++) {
+    if (strcmp(userprogs[i].name, name) == 0) return userprogs[i].binary;
+  }
+  return NULL;
+}
+
+static bool is_image_page(struct PageInfo *pp) {
+  uint8_t *kva = page2kva(pp);
+  uint8_t *start = ROUNDDOWN((uint8_t*)__userprogs_start, PGSIZE);
+  return kva >= start && kva < __userprogs_end;
+}
+
+// Return the kernel address of a page at `va` in `e` that `e` owns,
+// allocating a zeroed one if there is none
+// A page of the image mapped there by an earlier segment, or still only
+// in its VMA_FILE area, is replaced by a copy of it.
+static uint8_t* load_private_page(struct Env *e, uintptr_t va, int perm) {
+  pte_t *pte;
+  struct PageInfo *old = page_lookup(e->env_pgdir, (void*)va, &pte);
+  if (old && !is_image_page(old)) {
+    *pte |= perm;
+    return page2kva(old);
+  }
+  
+  const uint8_t *image = NULL;
+  if (old) {
+    image = page2kva(old);
+    perm |= *pte & PTE_W;
+  }
+  struct Vma *v = vma_lookup(e, va);
+  if (v && v->vma_type == VMA_FILE) {
+    image = v->vma_file + (va - v->vma_start);
+    perm |= v->vma_perm & PTE_W;
+    if (vma_remove(e, va, va + PGSIZE) < 0) return NULL;
+  }
+  
+  struct PageInfo *pp = page_alloc(image ? 0 : ALLOC_ZERO);
+  if (!pp) return NULL;
+  if (image) memcpy(page2kva(pp), image, PGSIZE);
+  if (page_insert(e->env_pgdir, pp, (void*)va, perm) < 0) {
+    page_free(pp);
+    return NULL;
+  }
+  return page2kva(pp);
+}
+
+// Map the segment `ph` of the ELF image `binary` into `e`
+// Pages of a read-only segment that lie entirely within its file part
+// are the pages of the image itself, a VMA_FILE area mapped on first
+// touch without copying. Other
+// pages, i.e. those of writable segments and of the bss, are allocated,
+// zeroed and filled from the image.
+static int load_segment(struct Env *e, const uint8_t *binary,
+    const struct Proghdr *ph) {
+  uintptr_t va = ph->p_va;
+  uintptr_t end = va + ph->p_memsz;
+  uintptr_t fend = va + ph->p_filesz;
+  const uint8_t *src = binary + ph->p_offset;
+  bool writable = ph->p_flags & ELF_PROG_FLAG_WRITE;
+  bool shareable = !writable && PGOFF(va) == PGOFF(src);
+  int perm = PTE_U | (writable ? PTE_W : 0);
+  
+  for (uintptr_t a = ROUNDDOWN(va, PGSIZE); a < end; a += PGSIZE) {
+    // The part of the segment in this page is [lo, hi)
+    uintptr_t lo = MAX(a, va);
+    uintptr_t hi = MIN(a + PGSIZE, end);
+    
+    // A page shared with an earlier segment is loaded as a private one
+    if (shareable && hi <= fend && !vma_lookup(e, a) &&
+        !page_lookup(e->env_pgdir, (void*)a, NULL)) {
+      const uint8_t *page = ROUNDDOWN(src + (lo - va), PGSIZE);
+      int r = vma_insert_file(e, a, a + PGSIZE, perm, page);
+      if (r < 0) return r;
+      continue;
+    }
+    
+    uint8_t *kva = load_private_page(e, a, perm);
+    if (!kva) return -E_NO_MEM;
+    uintptr_t mid = MAX(lo, MIN(hi, fend));
+    memcpy(kva + PGOFF(lo), src + (lo - va), mid - lo);
+    memset(kva + PGOFF(mid), 0, hi - mid);
+  }
+  return 0;
+}
+
+// Set up the initial program binary, stack, and processor flags
+// for a user process
+// The segments of the ELF binary are mapped at the virtual addresses
+// in its program headers. The stack is a demand-zero area of
+// USTACKSIZE below USTACKTOP, of which the top page, used right away,
+// is mapped up front.
+static int load_icode(struct Env *e, const uint8_t *binary) {
+  const struct Elf *elf = (const struct Elf*)binary;
+  if (elf->e_magic != ELF_MAGIC) return -E_INVAL;
+  
+  const struct Proghdr *ph = (const struct Proghdr*)(binary + elf->e_phoff);
+  for (int i = 0; i < elf->e_phnum; i++, ph++) {
+    if (ph->p_type != ELF_PROG_LOAD) continue;
+    if (ph->p_filesz > ph->p_memsz ||
+        ph->p_va + ph->p_memsz < ph->p_va ||
+        ph->p_va + ph->p_memsz > UTOP) {
+      return -E_INVAL;
+    }
+    int r = load_segment(e, binary, ph);
+    if (r < 0) return r;
+  }
+  e->env_tf.tf_eip = elf->e_entry;
+  
+  int r = vma_insert(e, USTACKTOP - USTACKSIZE, USTACKTOP, VMA_ZERO,
+      PTE_U | PTE_W);
+  if (r < 0) return r;
+  struct PageInfo *stack = page_alloc(ALLOC_ZERO);
+  if (!stack) return -E_NO_MEM;
+  if (page_insert(e->env_pgdir, stack, (void*)(USTACKTOP - PGSIZE),
+        PTE_U | PTE_W) < 0) {
+    page_free(stack);
+    return -E_NO_MEM;
+  }
+  return 0;
+}
+
+// Allocate a new env with env_alloc, load the ELF binary into it
+// with load_icode, and set its env_type
+// The new env's parent ID is set to 0.
+int env_create(struct Env **newenv_store, const uint8_t *binary,
+    enum EnvType type) {
+  struct Env *e;
+  int r = env_alloc(&e, 0);
+  if (r < 0) return r;
+  if ((r = load_icode(e, binary)) < 0) {
+    env_free(e);
+    return r;
+  }
+  e->env_type = type;
+  if (newenv_store) *newenv_store = e;
+  return 0;
+}
+
+/**** Running environments ****/
+
+// Restores the register values in the Trapframe with the 'iret' instruction
+// This exits the kernel and starts executing some environment's code.
+// This function does not return.
+void env_pop_tf(struct Trapframe *tf) {
+  asm volatile(
+    "\tmovl %0,%%esp\n"
+    "\tpopal\n"
+    "\tpopl %%es\n"
+    "\tpopl %%ds\n"
+    "\taddl $0x8,%%esp\n" // skip tf_trapno and tf_errcode
+    "\tiret\n"
+    : : "g" (tf) : "memory");
+  panic("iret failed"); // mostly to placate the compiler
+}
+
+// Context switch from curenv to env e
+// This function does not return.
+void env_run(struct Env *e) {
+  if (curenv && curenv->env_status == ENV_RUNNING) {
+    curenv->env_status = ENV_RUNNABLE;
+  }
+  curenv = e;
+  e->env_status = ENV_RUNNING;
+  e->env_runs++;
+  // Reloading %cr3 flushes the TLB; skip it when resuming the same
+  // address space, e.g. after a system call
+  if (rcr3() != PADDR(e->env_pgdir)) lcr3(PADDR(e->env_pgdir));
+  env_pop_tf(&e->env_tf);
+}
+
+// Context to resume env_run_wait from, once no environment is runnable
+static void *env_wait_ctx[5];
+static bool env_waiting;
+
+// Run `e`, and any other runnable environment, until none is runnable,
+// e.g. because they have exited, then return
+// Traps from environments are taken on the stack below the caller's
+// frame, instead of at KSTACKTOP where they would overwrite it.
+void env_run_wait(struct Env *e) {
+  uintptr_t esp;
+  // The monitor may run this from a trap of another environment
+  struct Env *prev = curenv;
+  assert(!env_waiting);
+  env_waiting = true;
+  if (__builtin_setjmp(env_wait_ctx) == 0) {
+    asm volatile("movl %%esp,%0" : "=r" (esp));
+    trap_set_kstack(ROUNDDOWN(esp, 16));
+    env_run(e);
+  }
+  env_waiting = false;
+  curenv = prev;
+  trap_set_kstack(KSTACKTOP);
+}
+
+// Return to env_run_wait, if it is running environments
+void env_wait_done(void) {
+  if (env_waiting) __builtin_longjmp(env_wait_ctx, 1);
+}
+
+/**** Benchmarks ****/
+
+static struct Env *bench_env;
+
+static void bench_env_alloc_free(void) {
+  if (env_alloc(&bench_env, 0) < 0) panic("env_alloc failed");
+  env_free(bench_env);
+}
+BENCH(env_alloc_free, "env_alloc+env_free", NULL, bench_env_alloc_free,
+    NULL, 0);
+
+static void bench_envid2env_setup(void) {
+  if (env_alloc(&bench_env, 0) < 0) panic("env_alloc failed");
+}
+
+static void bench_envid2env(void) {
+  struct Env *e;
+  if (envid2env(bench_env->env_id, &e, false) < 0) panic("envid2env failed");
+}
+
+static void bench_envid2env_teardown(void) {
+  env_free(bench_env);
+}
+BENCH(envid2env, "envid2env", bench_envid2env_setup, bench_envid2env,
+    bench_envid2env_teardown, 0);
+
+static void bench_env_create_free(void) {
+  if (env_create(&bench_env, userprog_lookup("null"), ENV_TYPE_USER) < 0) {
+    panic("env_create failed");
+  }
+  env_free(bench_env);
+}
+BENCH(env_create_free, "env_create+env_free/null", NULL,
+    bench_env_create_free, NULL, 0);
+
+// End to end: create, run until the program exits, and free
+static void bench_env_spawn(void) {
+  if (env_create(&bench_env, userprog_lookup("null"), ENV_TYPE_USER) < 0) {
+    panic("env_create failed");
+  }
+  env_run_wait(bench_env);
+}
+BENCH(env_spawn, "env/spawn+exit/null", NULL, bench_env_spawn, NULL, 0);
+
+// Spawning a pre-initialized service: load the program and run its
+// initialization until it is ready to serve, versus cloning a template
+// frozen at that point. Both then run until the program exits.
+static struct Env *bench_tmpl;
+
+static void bench_spawn_cold(void) {
+  if (env_create(&bench_env, userprog_lookup("zygote"), ENV_TYPE_USER) < 0) {
+    panic("env_create failed");
+  }
+  env_run_wait(bench_env);
+  if (bench_env->env_status != ENV_TEMPLATE) panic("zygote did not freeze");
+  env_free(bench_env);
+}
+BENCH(env_spawn_cold, "env/spawn/cold/zygote", NULL, bench_spawn_cold,
+    NULL, 0);
+
+static void bench_spawn_clone_setup(void) {
+  if (env_create(&bench_tmpl, userprog_lookup("zygote"), ENV_TYPE_USER) < 0) {
+    panic("env_create failed");
+  }
+  env_run_wait(bench_tmpl);
+}
+
+static void bench_spawn_clone(void) {
+  if (env_clone(&bench_env, bench_tmpl) < 0) panic("env_clone failed");
+  env_run_wait(bench_env);
+}
+
+static void bench_spawn_clone_teardown(void) {
+  env_free(bench_tmpl);
+}
+BENCH(env_spawn_clone, "env/spawn/clone/zygote", bench_spawn_clone_setup,
+    bench_spawn_clone, bench_spawn_clone_teardown, 0);
+
+// fork+exit of an environment with 64 MiB of writable memory, copying
+// it on write versus eagerly. The parent never runs; the child runs
+// the null program from its start and exits.
+// The eager copy needs QEMU with more than 128 MiB of memory.
+#define BENCH_FORK_VA 0x10000000
+#define BENCH_FORK_SIZE (64 * 1024 * 1024)
+
+static struct Env *bench_parent;
+
+static void bench_fork_setup(void) {
+  if (env_create(&bench_parent, userprog_lookup("null"), ENV_TYPE_USER) < 0) {
+    panic("env_create failed");
+  }
+  bench_parent->env_status = ENV_NOT_RUNNABLE;
+  for (uintptr_t va = BENCH_FORK_VA; va < BENCH_FORK_VA + BENCH_FORK_SIZE;
+      va += PGSIZE) {
+    struct PageInfo *pp = page_alloc(ALLOC_ZERO);
+    if (!pp || page_insert(bench_parent->env_pgdir, pp, (void*)va,
+          PTE_U | PTE_W) < 0) {
+      panic("bench_fork_setup: out of memory");
+    }
+  }
+}
+
+static void bench_fork_teardown(void) {
+  env_free(bench_parent);
+}
+
+static void bench_fork_cow(void) {
+  if (env_fork(&bench_env, bench_parent) < 0) panic("env_fork failed");
+  env_run_wait(bench_env);
+}
+BENCH(fork_cow, "env/fork+exit/64MiB/cow", bench_fork_setup,
+    bench_fork_cow, bench_fork_teardown, 10);
+
+// Fork by copying every writable page up front
+// Read-only pages and PTE_SHARE pages are still shared, and the rest of
+// the child's state is inherited like env_fork does.
+static int env_fork_eager(struct Env **newenv_store, struct Env *parent) {
+  struct Env *e;
+  int r = env_alloc(&e, parent->env_id);
+  if (r < 0) return r;
+  if ((r = env_inherit(e, parent)) < 0) goto nomem;
+  
+  for (int pdeno = 0; pdeno < PDX(UTOP); pdeno++) {
+    if (!(parent->env_pgdir[pdeno] & PTE_P)) continue;
+    pte_t *pt = KADDR(PTE_ADDR(parent->env_pgdir[pdeno]));
+    for (int pteno = 0; pteno < NPTENTRIES; pteno++) {
+      if (!(pt[pteno] & PTE_P)) continue;
+      void *va = PGADDR(pdeno, pteno, 0);
+      struct PageInfo *pp = pa2page(PTE_ADDR(pt[pteno]));
+      int perm = PGOFF(pt[pteno]) & PTE_SYSCALL;
+      if ((perm & (PTE_W | PTE_COW)) && !(perm & PTE_SHARE)) {
+        perm = (perm & ~PTE_COW) | PTE_W;
+        struct PageInfo *copy = page_alloc(0);
+        if (!copy) goto nomem;
+        memcpy(page2kva(copy), page2kva(pp), PGSIZE);
+        pp = copy;
+      }
+      if (page_insert(e->env_pgdir, pp, va, perm) < 0) {
+        if (pp->pp_ref == 0) page_free(pp);
+        goto nomem;
+      }
+    }
+  }
+  e->env_tf.tf_regs.reg_eax = 0;
+  *newenv_store = e;
+  return 0;
+  
+nomem:
+  env_free(e);
+  return -E_NO_MEM;
+}
+
+static void bench_fork_eager(void) {
+  if (env_fork_eager(&bench_env, bench_parent) < 0) {
+    panic("env_fork_eager failed");
+  }
+  env_run_wait(bench_env);
+}
+BENCH(fork_eager, "env/fork+exit/64MiB/eager", bench_fork_setup,
+    bench_fork_eager, bench_fork_teardown, 10);
@@ -5,5 +5,23 @@
 
 extern struct Env *envs;
 extern struct Env *curenv;
+extern struct Segdesc gdt[];
+
+void env_init(void);
+void env_init_percpu(void);
+int env_alloc(struct Env **newenv_store, envid_t parent_id);
+void env_free(struct Env *e);
+void env_destroy(struct Env *e);
+int envid2env(envid_t envid, struct Env **env_store, bool checkperm);
+const uint8_t* userprog_lookup(const char *name);
+int env_create(struct Env **newenv_store, const uint8_t *binary,
+    enum EnvType type);
+int env_fork(struct Env **newenv_store, struct Env *parent);
+void env_make_template(struct Env *e);
+int env_clone(struct Env **newenv_store, struct Env *tmpl);
+void env_run(struct Env *e);
+void env_pop_tf(struct Trapframe *tf);
+void env_run_wait(struct Env *e);
+void env_wait_done(void);
 
 #endif // KERN_ENV_H
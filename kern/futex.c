@@ -0,0 +1,76 @@
+#include <kern/futex.h>
+#include <inc/error.h>
+#include <inc/assert.h>
+#include <kern/env.h>
+#include <kern/sched.h>
+
+// A futex is a word of user memory that environments wait on until
+// another one wakes them. It is identified by the physical address of
+// the word, so that environments sharing the page, at whatever address,
+// wait on the same futex. Waiters are queued in FIFO order in a hash
+// table, and woken in that order. Each environment waits on at most one
+// futex at a time, so the waiters are kept in an array indexed by ENVX.
+// Timeouts of waits are those of sched_block.
+
+struct FutexWaiter {
+  struct FutexWaiter *next;
+  struct FutexWaiter **pprev; // NULL if the environment is not waiting
+  physaddr_t key;
+  struct Env *env;
+};
+
+static struct FutexWaiter waiters[NENV];
+static struct FutexWaiter *futex_hash[FUTEX_HASHSIZE];
+
+static struct FutexWaiter **futex_bucket(physaddr_t key) {
+  // Futexes are 4-byte aligned, so the low bits carry no information
+  return &futex_hash[((key >> 2) * 0x9E3779B1u) >> 26];
+}
+
+static void futex_dequeue(struct FutexWaiter *w) {
+  if (w->next) w->next->pprev = w->pprev;
+  *w->pprev = w->next;
+  w->pprev = NULL;
+}
+
+// Queue `e` as a waiter on the futex `key`
+// The caller blocks `e` afterwards with sched_block. futex_wake makes it
+// runnable without touching its registers.
+// Returns 0 on success, or -E_INVAL if `e` is already waiting.
+int futex_wait(struct Env *e, physaddr_t key) {
+  struct FutexWaiter *w = &waiters[ENVX(e->env_id)];
+  if (w->pprev) return -E_INVAL;
+  w->key = key;
+  w->env = e;
+  
+  struct FutexWaiter **pp = futex_bucket(key);
+  while (*pp) pp = &(*pp)->next;
+  w->next = NULL;
+  w->pprev = pp;
+  *pp = w;
+  return 0;
+}
+
+// Wake up to `n` of the environments waiting on the futex `key`, in the
+// order they started waiting
+// Returns the number of environments woken.
+int futex_wake(physaddr_t key, int n) {
+  int nwoken = 0;
+  struct FutexWaiter *w = *futex_bucket(key);
+  while (w && nwoken < n) {
+    struct FutexWaiter *next = w->next;
+    if (w->key == key) {
+      futex_dequeue(w);
+      sched_wake(w->env);
+      nwoken++;
+    }
+    w = next;
+  }
+  return nwoken;
+}
+
+// Stop the wait of `e`, which timed out or is being freed, if it waits
+void futex_cancel(struct Env *e) {
+  struct FutexWaiter *w = &waiters[ENVX(e->env_id)];
+  if (w->pprev && w->env == e) futex_dequeue(w);
+}
@@ -0,0 +1,13 @@
+#ifndef KERN_FUTEX_H
+#define KERN_FUTEX_H
+
+#include <inc/env.h>
+
+// Number of buckets of wait queues, a power of 2
+#define FUTEX_HASHSIZE 64
+
+int futex_wait(struct Env *e, physaddr_t key);
+int futex_wake(physaddr_t key, int n);
+void futex_cancel(struct Env *e);
+
+#endif // KERN_FUTEX_H
@@ -3,19 +3,62 @@
 #include <kern/console.h>
 #include <kern/monitor.h>
 #include <kern/pmap.h>
+#include <kern/bench.h>
+#include <kern/env.h>
+#include <kern/trap.h>
+#include <kern/picirq.h>
+#include <kern/time.h>
+#include <kern/timer.h>
+
+// Boot arguments copied from the boot sector
+static char bootargs[BOOTARGSLEN];
+
+// Copy the value of boot argument `key=value` to `val`
+// Return false if there is no such argument
+static bool bootarg(const char *key, char *val, int len) {
+  int keylen = strlen(key);
+  for (char *p = bootargs; *p; ) {
+    while (*p == ' ') p++;
+    char *arg = p;
+    while (*p && *p != ' ') p++;
+    if (strncmp(arg, key, keylen) == 0 && arg[keylen] == '=') {
+      strlcpy(val, arg + keylen + 1, MIN(len, p - arg - keylen));
+      return true;
+    }
+  }
+  return false;
+}
 
 void i386_init(void) {
   extern char edata[], end[];
+  char suite[BOOTARGSLEN];
   
   // Clear uninitialized global data section (bss)
   memset(edata, 0, end - edata);
   
+  // Save boot arguments before the page holding the boot sector is reused
+  memcpy(bootargs, (char*)(KERNBASE + BOOTARGS), BOOTARGSLEN - 1);
+  
   // Initialize the console
   cons_init();
   
   // Initialize memory managements
   mem_init();
   
+  // Initialize environments, segmentation and trap handling
+  env_init();
+  trap_init();
+  
+  // Deliver device interrupts, e.g. of the console, to the IDT
+  pic_init();
+  
+  // Calibrate the clock and start the periodic tick
+  time_init();
+  timer_wheel_init();
+  
+  // Run the benchmarks selected by `bench=` and exit, if given
+  if (bootarg("bench", suite, sizeof(suite))) bench_boot(suite);
+  
   // Drop into the kernel monitor
   while(1) monitor(NULL);
 }
@@ -0,0 +1,159 @@
+// The local APIC manages internal (non-I/O) interrupts
+// See Chapter 8 & Appendix C of Intel processor manual volume 3
+#include <kern/lapic.h>
+#include <inc/x86.h>
+#include <inc/mmu.h>
+#include <inc/trap.h>
+#include <inc/stdio.h>
+#include <kern/pmap.h>
+#include <kern/cpu.h>
+#include <kern/time.h>
+
+// Local APIC registers, divided by 4 for use as uint32_t[] indices
+#define ID (0x0020/4) // ID
+#define VER (0x0030/4) // Version
+#define TPR (0x0080/4) // Task Priority
+#define EOI (0x00B0/4) // EOI
+#define SVR (0x00F0/4) // Spurious Interrupt Vector
+#define   ENABLE 0x00000100 //   Unit Enable
+#define ESR (0x0280/4) // Error Status
+#define TIMER (0x0320/4) // Local Vector Table 0 (TIMER)
+#define   X1 0x0000000B //   divide counts by 1
+#define   ONESHOT 0x00000000 //   Count down once
+#define   TSCDEADLINE 0x00040000 //   Fire when the TSC reaches MSR_TSC_DEADLINE
+#define PCINT (0x0340/4) // Performance Counter LVT
+#define LINT0 (0x0350/4) // Local Vector Table 1 (LINT0)
+#define LINT1 (0x0360/4) // Local Vector Table 2 (LINT1)
+#define ERROR (0x0370/4) // Local Vector Table 3 (ERROR)
+#define   MASKED 0x00010000 //   Interrupt masked
+#define TICR (0x0380/4) // Timer Initial Count
+#define TCCR (0x0390/4) // Timer Current Count
+#define TDCR (0x03E0/4) // Timer Divide Configuration
+
+#define CPUID_APIC (1 << 9) // CPUID.1:EDX
+#define CPUID_TSC_DEADLINE (1 << 24) // CPUID.1:ECX
+
+volatile uint32_t *lapic;
+
+struct CpuInfo cpus[NCPU];
+int ncpu = 1;
+
+static bool has_tsc_deadline;
+// APIC timer counts per TSC cycle as a 32.32 fixed point number
+// Used only without TSC-deadline mode
+static uint64_t lapic_per_tsc;
+
+static void lapicw(int index, int value) {
+  lapic[index] = value;
+  lapic[ID]; // wait for write to finish, by reading
+}
+
+// Measure the APIC timer frequency against the calibrated TSC
+static void lapic_timer_calibrate(void) {
+  lapicw(TDCR, X1);
+  lapicw(TIMER, MASKED | ONESHOT | (IRQ_OFFSET + IRQ_TIMER));
+  uint64_t wait = timeinfo.tsc_hz / 100;
+  lapicw(TICR, 0xFFFFFFFF);
+  uint64_t start = read_tsc();
+  while (read_tsc() - start < wait);
+  uint32_t counts = 0xFFFFFFFF - lapic[TCCR];
+  lapicw(TICR, 0);
+  lapic_per_tsc = ((uint64_t)counts << 32) / wait;
+}
+
+void lapic_init(void) {
+  uint32_t ecx, edx;
+  cpuid(1, NULL, NULL, &ecx, &edx);
+  if (!(edx & CPUID_APIC)) return;
+  
+  // lapic_init is called after the switch to kern_pgdir,
+  // so the LAPIC can be mapped in the MMIO region
+  lapic = mmio_map_region(rdmsr(MSR_APICBASE) & ~(PGSIZE-1), PGSIZE);
+  
+  // Enable local APIC; set spurious interrupt vector
+  lapicw(SVR, ENABLE | (IRQ_OFFSET + IRQ_SPURIOUS));
+  
+  // The timer is one-shot and disarmed until lapic_timer_arm
+  // TSC-deadline mode is preferred since it needs no conversion
+  // from TSC cycles and does not drift against the TSC
+  has_tsc_deadline = ecx & CPUID_TSC_DEADLINE;
+  if (has_tsc_deadline) {
+    lapicw(TIMER, TSCDEADLINE | (IRQ_OFFSET + IRQ_TIMER));
+    wrmsr(MSR_TSC_DEADLINE, 0);
+  } else {
+    lapic_timer_calibrate();
+    lapicw(TIMER, ONESHOT | (IRQ_OFFSET + IRQ_TIMER));
+  }
+  
+  // Leave LINT0 of the BSP enabled so that it can get
+  // interrupts from the 8259A chip
+  // Disable NMI (LINT1) on all CPUs
+  lapicw(LINT1, MASKED);
+  
+  // Disable performance counter overflow interrupts
+  // on machines that provide that interrupt entry
+  if (((lapic[VER]>>16) & 0xFF) >= 4) lapicw(PCINT, MASKED);
+  
+  // Map error interrupt to IRQ_ERROR
+  lapicw(ERROR, IRQ_OFFSET + IRQ_ERROR);
+  
+  // Clear error status register (requires back-to-back writes)
+  lapicw(ESR, 0);
+  lapicw(ESR, 0);
+  
+  // Ack any outstanding interrupts
+  lapicw(EOI, 0);
+  
+  // Enable interrupts on the APIC (but not on the processor)
+  lapicw(TPR, 0);
+  
+  cprintf("LAPIC timer: %s\n", has_tsc_deadline ? "TSC-deadline" : "one-shot");
+}
+
+// APIC IDs need not be dense, so an ID beyond cpus[] is taken as CPU 0,
+// the only one the kernel runs on
+int cpunum(void) {
+  if (!lapic) return 0;
+  uint32_t id = lapic[ID] >> 24;
+  return id < NCPU ? id : 0;
+}
+
+// Acknowledge interrupt
+void lapic_eoi(void) {
+  if (lapic) lapicw(EOI, 0);
+}
+
+// Arm the one-shot timer to interrupt when the TSC reaches `tsc`
+// A deadline that has already passed interrupts immediately.
+// Without TSC-deadline mode, deadlines more than 2^32 APIC timer counts
+// away interrupt early; the caller must re-arm then.
+void lapic_timer_arm(uint64_t tsc) {
+  if (has_tsc_deadline) {
+    wrmsr(MSR_TSC_DEADLINE, tsc);
+    return;
+  }
+  uint64_t now = read_tsc();
+  uint64_t delta = tsc > now ? tsc - now : 0;
+  // (delta * lapic_per_tsc) >> 32, split into 32-bit halves so that
+  // no product overflows, and saturated at the largest count
+  uint32_t dh = delta >> 32, dl = delta;
+  uint32_t ph = lapic_per_tsc >> 32, pl = lapic_per_tsc;
+  uint64_t ticks = (uint64_t)dl * ph + (((uint64_t)dl * pl) >> 32);
+  if (dh && (ph || (uint64_t)dh * pl > 0xFFFFFFFF)) {
+    ticks = 0xFFFFFFFF;
+  } else {
+    ticks += (uint64_t)dh * pl;
+  }
+  uint32_t count = ticks > 0xFFFFFFFF ? 0xFFFFFFFF : ticks;
+  // An initial count of 0 stops the timer
+  lapicw(TICR, count ? count : 1);
+}
+
+// Disarm the timer
+void lapic_timer_stop(void) {
+  if (has_tsc_deadline) {
+    wrmsr(MSR_TSC_DEADLINE, 0);
+  } else {
+    lapicw(TICR, 0);
+  }
+}
@@ -0,0 +1,16 @@
+#ifndef KERN_LAPIC_H
+#define KERN_LAPIC_H
+
+#include <inc/types.h>
+
+#define MSR_APICBASE 0x01B // Local APIC base address
+#define MSR_TSC_DEADLINE 0x6E0 // TSC value at which the APIC timer fires
+
+extern volatile uint32_t *lapic; // NULL if there is no local APIC
+
+void lapic_init(void);
+void lapic_eoi(void);
+void lapic_timer_arm(uint64_t tsc);
+void lapic_timer_stop(void);
+
+#endif // KERN_LAPIC_H
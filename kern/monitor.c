@@ -2,6 +2,14 @@
 #include <inc/stdio.h>
 #include <inc/string.h>
 #include <inc/memlayout.h>
+#include <kern/bench.h>
+#include <kern/trap.h>
+#include <kern/console.h>
+#include <kern/time.h>
+#include <kern/cpu.h>
+#include <kern/timer.h>
+#include <kern/env.h>
+#include <kern/vma.h>
 
 struct Command {
   const char *name;
@@ -12,6 +20,17 @@ struct Command {
 static struct Command commands[] = {
   {"help", "Display this list of commands", mon_help},
   {"kerninfo", "Display infomation about the kernel", mon_kerninfo},
+  {"traps", "Display per-vector trap counts and handling cycles", mon_traps},
+  {"timer", "Display per-CPU timer interrupts and idle residency", mon_timer},
+  {"bench", "Run microbenchmarks whose names start with the arguments",
+    mon_bench},
+  {"run", "Run an embedded user program until it exits", mon_run},
+  {"clone", "Run a clone of a template environment until it exits",
+    mon_clone},
+  {"vm", "Display page faults per environment, or set the fault-around pages",
+    mon_vm},
+  {"continue", "Resume the environment that trapped into the monitor",
+    mon_continue},
 };
 
 /**** Implementation of basic kernel monitor commands ****/
@@ -34,6 +53,126 @@ int mon_kerninfo(int argc, char **argv, struct Trapframe *tf) {
   return 0;
 }
 
+int mon_traps(int argc, char **argv, struct Trapframe *tf) {
+  print_trap_stats();
+  cprintf("console input dropped: %u\n", cons_dropped());
+  return 0;
+}
+
+int mon_timer(int argc, char **argv, struct Trapframe *tf) {
+  uint64_t uptime = time_ns();
+  cprintf("uptime %llu ms, %u timers pending\n",
+      uptime / 1000000, timer_npending());
+  cprintf("cpu  timer irqs  idle entries  idle ms  idle%%\n");
+  for (int i=0; i<ncpu; i++) {
+    uint64_t idle = cycles_to_ns(cpus[i].idle_cycles);
+    cprintf("%3d  %10llu  %12llu  %7llu  %4llu\n", i, cpus[i].timer_irqs,
+        cpus[i].idle_entries, idle / 1000000, idle * 100 / (uptime + 1));
+  }
+  return 0;
+}
+
+int mon_bench(int argc, char **argv, struct Trapframe *tf) {
+  if (argc == 1) {
+    bench_run_all(NULL);
+    return 0;
+  }
+  for (int i=1; i<argc; i++) {
+    if (bench_run_all(argv[i]) == 0) {
+      cprintf("No benchmark matches '%s'\n", argv[i]);
+    }
+  }
+  return 0;
+}
+
+// Run `e` until it exits or becomes a template
+static void run_env(struct Env *e) {
+  envid_t envid = e->env_id;
+  uint64_t start = time_cycles();
+  env_run_wait(e);
+  uint64_t us = cycles_to_ns(time_cycles() - start) / 1000;
+  if (e->env_id == envid && e->env_status == ENV_TEMPLATE) {
+    cprintf("[%08x] became a template after %llu us\n", envid, us);
+  } else {
+    // The counts stay in the Env until it is allocated again
+    cprintf("[%08x] exited after %llu us, %u page faults, %u pages around\n",
+        envid, us, e->env_pgfaults, e->env_pgfaults_around);
+  }
+}
+
+int mon_run(int argc, char **argv, struct Trapframe *tf) {
+  if (argc != 2) {
+    cprintf("Usage: run <program>\n");
+    return 0;
+  }
+  // The monitor may have been entered from a trap of an environment
+  if (tf != NULL) {
+    cprintf("An environment is already running\n");
+    return 0;
+  }
+  const uint8_t *binary = userprog_lookup(argv[1]);
+  if (!binary) {
+    cprintf("Unknown program '%s'\n", argv[1]);
+    return 0;
+  }
+  struct Env *e;
+  int r = env_create(&e, binary, ENV_TYPE_USER);
+  if (r < 0) {
+    cprintf("env_create: %e\n", r);
+    return 0;
+  }
+  run_env(e);
+  return 0;
+}
+
+int mon_clone(int argc, char **argv, struct Trapframe *tf) {
+  if (argc != 2) {
+    cprintf("Usage: clone <envid>\n");
+    return 0;
+  }
+  if (tf != NULL) {
+    cprintf("An environment is already running\n");
+    return 0;
+  }
+  struct Env *tmpl, *e;
+  int r = envid2env(strtol(argv[1], NULL, 16), &tmpl, false);
+  if (r == 0) r = env_clone(&e, tmpl);
+  if (r < 0) {
+    cprintf("env_clone: %e\n", r);
+    return 0;
+  }
+  run_env(e);
+  return 0;
+}
+
+int mon_vm(int argc, char **argv, struct Trapframe *tf) {
+  if (argc > 2) {
+    cprintf("Usage: vm [fault-around pages]\n");
+    return 0;
+  }
+  if (argc == 2 && vma_set_fault_around(strtol(argv[1], NULL, 0)) < 0) {
+    cprintf("Fault-around pages must be a power of 2 up to %d\n", NPTENTRIES);
+    return 0;
+  }
+  cprintf("fault-around %d pages\n", vma_get_fault_around());
+  cprintf("env       areas  page faults  pages around\n");
+  for (int i=0; i<NENV; i++) {
+    struct Env *e = &envs[i];
+    if (e->env_status == ENV_FREE) continue;
+    cprintf("%08x  %5d  %11u  %12u\n", e->env_id, e->env_nvma,
+        e->env_pgfaults, e->env_pgfaults_around);
+  }
+  return 0;
+}
+
+int mon_continue(int argc, char **argv, struct Trapframe *tf) {
+  if (tf == NULL) {
+    cprintf("No environment to continue\n");
+    return 0;
+  }
+  return -1;
+}
+
 /**** Kernel monitor command interpreter ****/
 
 #define WHITESPACE "\t\r\n "
@@ -74,6 +213,7 @@ void monitor(struct Trapframe *tf) {
   char *buf;
   cprintf("Welcome to the JOS kernel monitor\n");
   cprintf("Type 'help' for a list of commands\n");
+  if (tf != NULL) print_trapframe(tf);
   while(1) {
     buf = readline("K> ");
     if (buf != NULL) {
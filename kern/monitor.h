@@ -7,5 +7,12 @@ void monitor(struct Trapframe *tf);
 
 int mon_help(int argc, char **argv, struct Trapframe *tf);
 int mon_kerninfo(int argc, char **argv, struct Trapframe *tf);
+int mon_traps(int argc, char **argv, struct Trapframe *tf);
+int mon_timer(int argc, char **argv, struct Trapframe *tf);
+int mon_bench(int argc, char **argv, struct Trapframe *tf);
+int mon_run(int argc, char **argv, struct Trapframe *tf);
+int mon_clone(int argc, char **argv, struct Trapframe *tf);
+int mon_vm(int argc, char **argv, struct Trapframe *tf);
+int mon_continue(int argc, char **argv, struct Trapframe *tf);
 
 #endif // KERN_MONITOR_H
@@ -0,0 +1,93 @@
+#include <kern/picirq.h>
+#include <inc/stdio.h>
+#include <inc/x86.h>
+#include <inc/trap.h>
+#include <kern/trap.h>
+
+// Current IRQ mask
+// Initial IRQ mask has interrupt 2 enabled (for slave 8259A)
+uint16_t irq_mask_8259A = 0xFFFF & ~(1<<IRQ_SLAVE);
+// Set once the PICs deliver interrupts to the IDT vectors of trap_init
+bool pic_ready = false;
+
+// The master PIC raises IRQ 7 when an interrupt goes away before it is
+// acknowledged; such an interrupt must not be acknowledged
+static void spurious_irq(struct Trapframe *tf) {
+  cprintf("spurious interrupt on irq 7\n");
+}
+
+// Initialize the 8259A interrupt controllers
+void pic_init(void) {
+  // mask all interrupts
+  outb(IO_PIC1+1, 0xFF);
+  outb(IO_PIC2+1, 0xFF);
+  
+  // Set up master (8259A-1)
+  
+  // ICW1:  0001g0hi
+  //    g:  0 = edge triggering, 1 = level triggering
+  //    h:  0 = cascaded PICs, 1 = master only
+  //    i:  0 = no ICW4, 1 = ICW4 required
+  outb(IO_PIC1, 0x11);
+  
+  // ICW2:  Vector offset
+  outb(IO_PIC1+1, IRQ_OFFSET);
+  
+  // ICW3:  bit mask of IR lines connected to slave PICs (master PIC),
+  //        3-bit No of IR line at which slave connects to master(slave PIC).
+  outb(IO_PIC1+1, 1<<IRQ_SLAVE);
+  
+  // ICW4:  000nbmap
+  //    n:  1 = special fully nested mode
+  //    b:  1 = buffered mode
+  //    m:  0 = slave PIC, 1 = master PIC
+  //        (ignored when b is 0, as the master/slave role
+  //        can be hardwired).
+  //    a:  1 = Automatic EOI mode
+  //    p:  0 = MCS-80/85 mode, 1 = intel x86 mode
+  // Interrupts are acknowledged explicitly by irq_eoi
+  outb(IO_PIC1+1, 0x1);
+  
+  // Set up slave (8259A-2)
+  outb(IO_PIC2, 0x11); // ICW1
+  outb(IO_PIC2+1, IRQ_OFFSET + 8); // ICW2
+  outb(IO_PIC2+1, IRQ_SLAVE); // ICW3
+  outb(IO_PIC2+1, 0x01); // ICW4
+  
+  // OCW3:  0ef01prs
+  //   ef:  0x = NOP, 10 = clear specific mask, 11 = set specific mask
+  //    p:  0 = no polling, 1 = polling mode
+  //   rs:  0x = NOP, 10 = read IRR, 11 = read ISR
+  outb(IO_PIC1, 0x68); // clear specific mask
+  outb(IO_PIC1, 0x0a); // read IRR by default
+  
+  outb(IO_PIC2, 0x68); // OCW3
+  outb(IO_PIC2, 0x0a); // OCW3
+  
+  trap_register(IRQ_OFFSET + IRQ_SPURIOUS, spurious_irq);
+  
+  pic_ready = true;
+  irq_setmask_8259A(irq_mask_8259A);
+}
+
+void irq_setmask_8259A(uint16_t mask) {
+  irq_mask_8259A = mask;
+  if (!pic_ready) return;
+  outb(IO_PIC1+1, (char)mask);
+  outb(IO_PIC2+1, (char)(mask >> 8));
+  cprintf("enabled interrupts:");
+  for (int i = 0; i < MAX_IRQS; i++) {
+    if (~mask & (1<<i)) cprintf(" %d", i);
+  }
+  cprintf("\n");
+}
+
+void irq_enable(int irq) {
+  irq_setmask_8259A(irq_mask_8259A & ~(1<<irq));
+}
+
+// Acknowledge an interrupt, so that the PICs deliver the next one
+void irq_eoi(int irq) {
+  if (irq >= 8) outb(IO_PIC2, PIC_EOI);
+  outb(IO_PIC1, PIC_EOI);
+}
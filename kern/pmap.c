@@ -6,7 +6,9 @@
 #include <inc/string.h>
 
 #include <kern/env.h>
+#include <kern/vma.h>
 #include <kern/kclock.h>
+#include <kern/bench.h>
 
 // These variables are set by i386_detect_memory()
 size_t npages; // The amount of physical memory (in pages)
@@ -172,8 +174,44 @@ void page_free(struct PageInfo *pp) {
   page_free_list = pp;
 }
 
+/**** Shared page tables ****/
+
+// Environments cloned from a template (see env_clone) share its page
+// tables below UTOP. Each page directory that points to a page table
+// holds a reference to it, and the page table holds one reference to
+// each page it maps, however many page directories point to it.
+// Writable pages in shared page tables are mapped copy-on-write, so
+// only changing a mapping requires a private copy of the page table.
+
+static bool pt_shared(pde_t *pgdir, int pdx) {
+  return pdx < PDX(UTOP) && (pgdir[pdx] & PTE_P) &&
+    pa2page(PTE_ADDR(pgdir[pdx]))->pp_ref > 1;
+}
+
+// Replace the shared page table at pgdir[pdx] by a private copy
+// The copy maps the same pages, so TLB entries stay valid.
+// Returns 0, or -E_NO_MEM
+static int pt_unshare(pde_t *pgdir, int pdx) {
+  struct PageInfo *old = pa2page(PTE_ADDR(pgdir[pdx]));
+  struct PageInfo *pg = page_alloc(0);
+  if (!pg) return -E_NO_MEM;
+  pte_t *pt = page2kva(pg);
+  memcpy(pt, page2kva(old), PGSIZE);
+  for (int i = 0; i < NPTENTRIES; i++) {
+    if (pt[i] & PTE_P) pa2page(PTE_ADDR(pt[i]))->pp_ref++;
+  }
+  pg->pp_ref++;
+  pgdir[pdx] = page2pa(pg) | PGOFF(pgdir[pdx]);
+  page_decref(old);
+  return 0;
+}
+
+/**** Page mappings ****/
+
 // Given `pgdir`, a pointer to a page directory, pgdir_walk returns
 // a pointer to the page table entry (PTE) for linear address `va
+// With `create`, a missing page table is allocated, and a shared one
+// is copied, so that the caller may change the PTE.
 pde_t* pgdir_walk(pde_t *pgdir, const void *va, int create) {
   int dindex = PDX(va);
   if (!(pgdir[dindex] & PTE_P)) {
@@ -185,6 +223,8 @@ pde_t* pgdir_walk(pde_t *pgdir, const void *va, int create) {
     } else {
       return NULL;
     }
+  } else if (create && pt_shared(pgdir, dindex)) {
+    if (pt_unshare(pgdir, dindex) < 0) return NULL;
   }
   pte_t *p = KADDR(PTE_ADDR(pgdir[dindex]));
   int tindex = PTX(va);
@@ -209,6 +249,18 @@ static void boot_map_region(
   }
 }
 
+// Reserve size bytes in the MMIO region and map [pa, pa+size) there
+// with caching disabled. Returns the virtual address of the region.
+void* mmio_map_region(physaddr_t pa, size_t size) {
+  static uintptr_t base = MMIOBASE;
+  uintptr_t ret = base;
+  size = ROUNDUP(size, PGSIZE);
+  if (base + size > MMIOLIM) panic("mmio_map_region: out of MMIO region");
+  boot_map_region(kern_pgdir, base, size, pa, PTE_PCD | PTE_PWT | PTE_W);
+  base += size;
+  return (void*)ret;
+}
+
 // Return the page mapped at virtual address `va`
 // If `pte_store` is not zero,
 // then we store the address of the pte for this page in it
@@ -233,13 +285,47 @@ void tlb_invalidate(pde_t *pgdir, void *va) {
 
 // Unmap the physical page at virtual address `va`
 // If there is no physical page at that address, this function does nothing
-void page_remove(pde_t *pgdir, void *va) {
+// Returns 0 on success, or -E_NO_MEM if the page table is shared and
+// there is no memory for a private copy of it
+int page_remove(pde_t *pgdir, void *va) {
   pte_t *pte;
   struct PageInfo *pg = page_lookup(pgdir, va, &pte);
-  if (!pg || !(*pte & PTE_P)) return;
+  if (!pg || !(*pte & PTE_P)) return 0;
+  if (pt_shared(pgdir, PDX(va))) {
+    if (pt_unshare(pgdir, PDX(va)) < 0) return -E_NO_MEM;
+    pte = pgdir_walk(pgdir, va, 0);
+  }
   page_decref(pg);
   *pte = 0;
   tlb_invalidate(pgdir, va);
+  return 0;
+}
+
+// Unmap the pages in [start, end)
+// Ranges without a page table are skipped as a whole. Shared page tables
+// in the range are copied first, so that nothing is unmapped on error.
+// Returns 0 on success, or -E_NO_MEM
+int page_remove_range(pde_t *pgdir, uintptr_t start, uintptr_t end) {
+  for (uintptr_t va = ROUNDDOWN(start, PTSIZE); va < end; va += PTSIZE) {
+    if ((pgdir[PDX(va)] & PTE_P) && pt_shared(pgdir, PDX(va)) &&
+        pt_unshare(pgdir, PDX(va)) < 0) {
+      return -E_NO_MEM;
+    }
+    if (va + PTSIZE == 0) break;
+  }
+  
+  uintptr_t va = start;
+  while (va < end) {
+    if (!(pgdir[PDX(va)] & PTE_P)) {
+      va = ROUNDDOWN(va, PTSIZE) + PTSIZE;
+      if (va == 0) break;
+      continue;
+    }
+    int r = page_remove(pgdir, (void*)va);
+    if (r < 0) return r;
+    va += PGSIZE;
+  }
+  return 0;
 }
 
 // Map the physical page `pp` at virtual addrss `va`
@@ -247,11 +333,85 @@ int page_insert(pde_t *pgdir, struct PageInfo *pp, void *va, int perm) {
   pte_t *pte = pgdir_walk(pgdir, va, 1);
   if (!pte) return -E_NO_MEM;
   pp->pp_ref++;
+  // The page table is private now, so this cannot fail
   if (*pte & PTE_P) page_remove(pgdir, va);
   *pte = page2pa(pp) | perm | PTE_P;
   return 0;
 }
 
+// Give `pgdir` a private, writable copy of the copy-on-write page at `va`
+// The last mapping of a page is made writable again without copying.
+// Returns 0 on success, < 0 on error. Errors are:
+//   -E_FAULT if there is no copy-on-write page at va
+//   -E_NO_MEM on memory exhaustion
+int page_copy_on_write(pde_t *pgdir, void *va) {
+  pte_t *pte = pgdir_walk(pgdir, va, 0);
+  if (!pte || (*pte & (PTE_P | PTE_COW)) != (PTE_P | PTE_COW)) return -E_FAULT;
+  // pp_ref counts the mappings of the page only in private page tables
+  if (!(pte = pgdir_walk(pgdir, va, 1))) return -E_NO_MEM;
+  
+  struct PageInfo *old = pa2page(PTE_ADDR(*pte));
+  if (old->pp_ref == 1) {
+    *pte = (*pte & ~PTE_COW) | PTE_W;
+    tlb_invalidate(pgdir, va);
+    return 0;
+  }
+  int perm = (PGOFF(*pte) & PTE_SYSCALL & ~PTE_COW) | PTE_W;
+  struct PageInfo *pg = page_alloc(0);
+  if (!pg) return -E_NO_MEM;
+  memcpy(page2kva(pg), page2kva(old), PGSIZE);
+  if (page_insert(pgdir, pg, va, perm) < 0) {
+    page_free(pg);
+    return -E_NO_MEM;
+  }
+  return 0;
+}
+
+static uintptr_t user_mem_check_addr;
+
+// Check that an environment is allowed to access the range of memory
+// [va, va+len) with permissions 'perm | PTE_P'
+// If there is an error, set the 'user_mem_check_addr' variable to the first
+// erroneous virtual address.
+// Returns 0 if the user program can access this range of addresses,
+// and -E_FAULT otherwise.
+int user_mem_check(struct Env *env, const void *va, size_t len, int perm) {
+  uintptr_t start = (uintptr_t)va, end = start + len;
+  perm |= PTE_P;
+  if (end < start) {
+    user_mem_check_addr = start;
+    return -E_FAULT;
+  }
+  for (uintptr_t a = ROUNDDOWN(start, PGSIZE); a < end; a += PGSIZE) {
+    pte_t *pte = a < ULIM ? pgdir_walk(env->env_pgdir, (void*)a, 0) : NULL;
+    // Map a missing page of a demand-zero area, as touching it would
+    if ((!pte || !(*pte & PTE_P)) && a < UTOP &&
+        vma_fault(env, a, (perm & PTE_W) ? FEC_WR : 0) == 0) {
+      pte = pgdir_walk(env->env_pgdir, (void*)a, 0);
+    }
+    if (!pte || (*pte & perm) != perm) {
+      user_mem_check_addr = MAX(a, start);
+      return -E_FAULT;
+    }
+    // The last page may end exactly at 2^32
+    if (a + PGSIZE < a) break;
+  }
+  return 0;
+}
+
+// Checks that environment 'env' is allowed to access the range
+// of memory [va, va+len) with permissions 'perm | PTE_U | PTE_P'
+// If it can, then the function simply returns.
+// If it cannot, 'env' is destroyed and, if env is the current
+// environment, this function will not return.
+void user_mem_assert(struct Env *env, const void *va, size_t len, int perm) {
+  if (user_mem_check(env, va, len, perm | PTE_U) < 0) {
+    cprintf("[%08x] user_mem_check assertion failure for va %08x\n",
+        env->env_id, user_mem_check_addr);
+    env_destroy(env); // may not return
+  }
+}
+
 /**** Test functions ****/
 
 // Check that the pages on the page_free_list are reasonable
@@ -622,3 +782,53 @@ static void check_page_installed_pgdir(void) {
   // free the pages we took
   page_free(pp0);
 }
+
+/**** Benchmarks ****/
+
+// Unmapped in kern_pgdir, so page_insert there needs a new page table
+#define BENCH_VA UTEMP
+
+static struct PageInfo *bench_pp;
+
+static void bench_page_alloc_free(void) {
+  page_free(page_alloc(0));
+}
+BENCH(page_alloc_free, "page_alloc+page_free",
+    NULL, bench_page_alloc_free, NULL, 0);
+
+static void bench_page_alloc_zero_free(void) {
+  page_free(page_alloc(ALLOC_ZERO));
+}
+BENCH(page_alloc_zero_free, "page_alloc(ZERO)+page_free",
+    NULL, bench_page_alloc_zero_free, NULL, 0);
+
+static void bench_pgdir_walk_hit(void) {
+  pgdir_walk(kern_pgdir, (void*)KERNBASE, 0);
+}
+BENCH(pgdir_walk_hit, "pgdir_walk/hit", NULL, bench_pgdir_walk_hit, NULL, 0);
+
+static void bench_pgdir_walk_miss(void) {
+  pgdir_walk(kern_pgdir, BENCH_VA, 0);
+}
+BENCH(pgdir_walk_miss, "pgdir_walk/miss",
+    NULL, bench_pgdir_walk_miss, NULL, 0);
+
+// Hold a reference to `bench_pp` so that page_remove never frees it
+static void bench_page_insert_setup(void) {
+  if (!(bench_pp = page_alloc(0))) panic("Out of memory");
+  bench_pp->pp_ref++;
+}
+
+static void bench_page_insert_remove(void) {
+  page_insert(kern_pgdir, bench_pp, BENCH_VA, PTE_W);
+  page_remove(kern_pgdir, BENCH_VA);
+}
+
+// Give back the page and the page table allocated for BENCH_VA
+static void bench_page_insert_teardown(void) {
+  page_decref(bench_pp);
+  page_decref(pa2page(PTE_ADDR(kern_pgdir[PDX(BENCH_VA)])));
+  kern_pgdir[PDX(BENCH_VA)] = 0;
+}
+BENCH(page_insert_remove, "page_insert+page_remove", bench_page_insert_setup,
+    bench_page_insert_remove, bench_page_insert_teardown, 0);
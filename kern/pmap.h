@@ -39,11 +39,18 @@ void page_init(void);
 struct PageInfo* page_alloc(int alloc_flags);
 void page_free(struct PageInfo *pp);
 int page_insert(pde_t *pgdir, struct PageInfo *pp, void *va, int perm);
-void page_remove(pde_t *pgdir, void *va);
+int page_remove(pde_t *pgdir, void *va);
+int page_remove_range(pde_t *pgdir, uintptr_t start, uintptr_t end);
 struct PageInfo *page_lookup(pde_t *pgdir, void *va, pte_t **pte_store);
 void page_decref(struct PageInfo *pp);
 void tlb_invalidate(pde_t *pgdir, void *va);
 pte_t *pgdir_walk(pde_t *pgdir, const void *va, int create);
+int page_copy_on_write(pde_t *pgdir, void *va);
+void* mmio_map_region(physaddr_t pa, size_t size);
+
+struct Env;
+int user_mem_check(struct Env *env, const void *va, size_t len, int perm);
+void user_mem_assert(struct Env *env, const void *va, size_t len, int perm);
 
 static inline physaddr_t page2pa(struct PageInfo *pp) {
   return (pp - pages) << PGSHIFT;
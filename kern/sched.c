@@ -0,0 +1,83 @@
+#include <kern/sched.h>
+#include <inc/stdio.h>
+#include <kern/env.h>
+#include <kern/monitor.h>
+#include <kern/futex.h>
+#include <kern/time.h>
+#include <kern/timer.h>
+
+// Timeouts of blocked environments, indexed by ENVX
+struct SchedTimeout {
+  struct Timer timer;
+  struct Env *env;
+  int32_t ret; // Returned by the system call of `env` on timeout
+};
+
+static struct SchedTimeout timeouts[NENV];
+static uint32_t sched_ntimeouts; // Number of pending timeouts
+
+// Choose a user environment to run and run it
+// Environments are picked round-robin, starting after the current one,
+// which runs again only if no other environment is runnable.
+// If none is, but a blocked one will time out, the CPU idles until then.
+// This function does not return.
+void sched_yield(void) {
+  int start = curenv ? ENVX(curenv->env_id) + 1 : 0;
+  while (1) {
+    for (int i = 0; i < NENV; i++) {
+      struct Env *e = &envs[(start + i) % NENV];
+      if (e->env_status == ENV_RUNNABLE) env_run(e);
+    }
+    if (curenv && curenv->env_status == ENV_RUNNING) env_run(curenv);
+    if (!sched_ntimeouts) sched_halt();
+    cpu_idle();
+  }
+}
+
+// No environment is runnable
+// Return to env_run_wait if it is waiting for that, and drop into the
+// kernel monitor otherwise.
+void sched_halt(void) {
+  curenv = NULL;
+  env_wait_done();
+  cprintf("No runnable environments in the system!\n");
+  while (1) monitor(NULL);
+}
+
+static void sched_timeout(struct Timer *t) {
+  struct SchedTimeout *st = t->arg;
+  struct Env *e = st->env;
+  sched_ntimeouts--;
+  // Stop whatever `e` waits for, so that nothing wakes it later
+  e->env_ipc_recving = false;
+  e->env_mq_waiting = false;
+  futex_cancel(e);
+  e->env_tf.tf_regs.reg_eax = st->ret;
+  e->env_status = ENV_RUNNABLE;
+}
+
+// Block `e` until sched_wake, for up to `timeout_ns` nanoseconds, or
+// without a time limit if it is 0
+// If the time runs out first, `e` becomes runnable again with its system
+// call returning `timeout_ret`.
+void sched_block(struct Env *e, uint64_t timeout_ns, int32_t timeout_ret) {
+  e->env_status = ENV_NOT_RUNNABLE;
+  if (!timeout_ns) return;
+  struct SchedTimeout *st = &timeouts[ENVX(e->env_id)];
+  st->env = e;
+  st->ret = timeout_ret;
+  timer_setup(&st->timer, sched_timeout, st);
+  timer_add_ns(&st->timer, timeout_ns);
+  sched_ntimeouts++;
+}
+
+// Make the blocked `e` runnable, cancelling its timeout
+void sched_wake(struct Env *e) {
+  sched_free(e);
+  e->env_status = ENV_RUNNABLE;
+}
+
+// Cancel the timeout of `e`, which is being freed, if it has one
+void sched_free(struct Env *e) {
+  if (timer_cancel(&timeouts[ENVX(e->env_id)].timer)) sched_ntimeouts--;
+}
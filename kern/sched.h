@@ -0,0 +1,12 @@
+#ifndef KERN_SCHED_H
+#define KERN_SCHED_H
+
+#include <inc/env.h>
+
+void sched_yield(void);
+void sched_halt(void);
+void sched_block(struct Env *e, uint64_t timeout_ns, int32_t timeout_ret);
+void sched_wake(struct Env *e);
+void sched_free(struct Env *e);
+
+#endif // KERN_SCHED_H
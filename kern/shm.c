@@ -0,0 +1,144 @@
+#include <kern/shm.h>
+#include <inc/mmu.h>
+#include <inc/error.h>
+#include <inc/string.h>
+#include <inc/assert.h>
+#include <kern/env.h>
+#include <kern/pmap.h>
+#include <kern/vma.h>
+
+// A shared memory object holds a reference to each of its pages, and
+// each mapping of them holds another through page_insert. Environments
+// open an object by name and map it at addresses of their choice. When
+// the last one closes it, the object and its name go away, and its
+// pages are freed once they are not mapped anymore.
+
+// Maximum number of pages of an object, whose list fills a page
+#define SHM_MAXPAGES (PGSIZE / sizeof(struct PageInfo*))
+
+struct Shm {
+  char shm_name[SHM_NAMELEN]; // Empty if the object is free
+  size_t shm_npages;
+  struct PageInfo **shm_pages; // Kernel address of the page listing them
+  int shm_nusers; // Number of environments that have it open
+};
+
+static struct Shm shms[NSHM];
+
+static void shm_destroy(struct Shm *s) {
+  for (size_t i = 0; i < s->shm_npages; i++) page_decref(s->shm_pages[i]);
+  page_decref(pa2page(PADDR(s->shm_pages)));
+  s->shm_name[0] = '\0';
+}
+
+// Create the object `name` of `npages` zeroed pages in the free `s`
+// Returns 0 on success, or -E_NO_MEM
+static int shm_create(struct Shm *s, const char *name, size_t npages) {
+  struct PageInfo *list = page_alloc(0);
+  if (!list) return -E_NO_MEM;
+  list->pp_ref++;
+  s->shm_pages = page2kva(list);
+  for (s->shm_npages = 0; s->shm_npages < npages; s->shm_npages++) {
+    struct PageInfo *pp = page_alloc(ALLOC_ZERO);
+    if (!pp) {
+      shm_destroy(s);
+      return -E_NO_MEM;
+    }
+    pp->pp_ref++;
+    s->shm_pages[s->shm_npages] = pp;
+  }
+  strcpy(s->shm_name, name);
+  s->shm_nusers = 0;
+  return 0;
+}
+
+// Open the object `name` for `e`, creating it with `len` bytes,
+// rounded up to pages, if there is none
+// Opening an object that `e` already has open does nothing.
+// Returns the id of the object on success, < 0 on error. Errors are:
+//   -E_INVAL if there is no object `name` and len is 0 or too large,
+//     or there is one, but smaller than len
+//   -E_NO_MEM if there are NSHM objects already, or on memory exhaustion
+int shm_open(struct Env *e, const char *name, size_t len) {
+  assert(name[0] && strlen(name) < SHM_NAMELEN);
+  size_t npages = ROUNDUP(len, PGSIZE) / PGSIZE;
+  struct Shm *s = NULL, *slot = NULL;
+  for (int i = 0; i < NSHM; i++) {
+    if (shms[i].shm_name[0] == '\0') {
+      if (!slot) slot = &shms[i];
+    } else if (strcmp(shms[i].shm_name, name) == 0) {
+      s = &shms[i];
+      break;
+    }
+  }
+  
+  if (s) {
+    if (npages > s->shm_npages) return -E_INVAL;
+  } else {
+    if (npages == 0 || npages > SHM_MAXPAGES) return -E_INVAL;
+    if (!slot) return -E_NO_MEM;
+    int r = shm_create(slot, name, npages);
+    if (r < 0) return r;
+    s = slot;
+  }
+  
+  int shmid = s - shms;
+  if (!(e->env_shm & (1u << shmid))) {
+    e->env_shm |= 1u << shmid;
+    s->shm_nusers++;
+  }
+  return shmid;
+}
+
+// Map the pages of object `shmid`, which `e` has open, at `va` in `e`
+// with permissions `perm`, marked PTE_SHARE so that they stay shared
+// across fork
+// Returns 0 on success, < 0 on error. Errors are:
+//   -E_INVAL if `e` does not have `shmid` open, or the pages do not fit
+//     below UTOP, or would be writable in a read-only area
+//   -E_NO_MEM if there's no memory to allocate any necessary page tables
+int shm_map(struct Env *e, int shmid, uintptr_t va, int perm) {
+  if (shmid < 0 || shmid >= NSHM || !(e->env_shm & (1u << shmid))) {
+    return -E_INVAL;
+  }
+  struct Shm *s = &shms[shmid];
+  if (va + s->shm_npages * PGSIZE < va || va + s->shm_npages * PGSIZE > UTOP) {
+    return -E_INVAL;
+  }
+  for (size_t i = 0; i < s->shm_npages; i++) {
+    if (!vma_allows(e, va + i * PGSIZE, perm)) return -E_INVAL;
+  }
+  for (size_t i = 0; i < s->shm_npages; i++) {
+    int r = page_insert(e->env_pgdir, s->shm_pages[i],
+        (void*)(va + i * PGSIZE), perm | PTE_SHARE);
+    if (r < 0) return r;
+  }
+  return 0;
+}
+
+// Close object `shmid` for `e`, destroying it if `e` was its last user
+// Its pages stay mapped where `e` mapped them.
+// Returns 0 on success, or -E_INVAL if `e` does not have it open
+int shm_close(struct Env *e, int shmid) {
+  if (shmid < 0 || shmid >= NSHM || !(e->env_shm & (1u << shmid))) {
+    return -E_INVAL;
+  }
+  e->env_shm &= ~(1u << shmid);
+  if (--shms[shmid].shm_nusers == 0) shm_destroy(&shms[shmid]);
+  return 0;
+}
+
+// Open the objects that `src` has open for `dst`, e.g. a forked child
+void shm_copy(struct Env *dst, struct Env *src) {
+  dst->env_shm = src->env_shm;
+  for (int i = 0; i < NSHM; i++) {
+    if (src->env_shm & (1u << i)) shms[i].shm_nusers++;
+  }
+}
+
+// Close all the objects that `e` has open
+void shm_free(struct Env *e) {
+  for (int i = 0; i < NSHM; i++) {
+    if (e->env_shm & (1u << i)) shm_close(e, i);
+  }
+}
@@ -0,0 +1,17 @@
+#ifndef KERN_SHM_H
+#define KERN_SHM_H
+
+#include <inc/env.h>
+
+// Maximum number of shared memory objects, one bit each in env_shm
+#define NSHM 32
+// Maximum length of the name of an object, including the NUL
+#define SHM_NAMELEN 32
+
+int shm_open(struct Env *e, const char *name, size_t len);
+int shm_map(struct Env *e, int shmid, uintptr_t va, int perm);
+int shm_close(struct Env *e, int shmid);
+void shm_copy(struct Env *dst, struct Env *src);
+void shm_free(struct Env *e);
+
+#endif // KERN_SHM_H
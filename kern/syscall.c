@@ -0,0 +1,671 @@
+#include <kern/syscall.h>
+#include <inc/x86.h>
+#include <inc/error.h>
+#include <inc/string.h>
+#include <inc/assert.h>
+
+#include <kern/env.h>
+#include <kern/pmap.h>
+#include <kern/console.h>
+#include <kern/sched.h>
+#include <kern/vma.h>
+#include <kern/shm.h>
+#include <kern/futex.h>
+#include <kern/bench.h>
+
+// Print a string to the system console
+// The string is exactly 'len' characters long
+// Destroys the environment on memory errors
+static void sys_cputs(const char *s, size_t len) {
+  // Check that the user has permission to read memory [s, s+len)
+  user_mem_assert(curenv, s, len, 0);
+  
+  cprintf("%.*s", len, s);
+}
+
+// Read a character from the system console without blocking
+// Returns the character, or 0 if there is no input waiting
+static int sys_cgetc(void) {
+  return cons_getc();
+}
+
+// Returns the current environment's envid
+static envid_t sys_getenvid(void) {
+  return curenv->env_id;
+}
+
+// Destroy a given environment (possibly the currently running environment)
+// Returns 0 on success, < 0 on error. Errors are:
+//   -E_BAD_ENV if environment envid doesn't currently exist,
+//     or the caller doesn't have permission to change envid
+static int sys_env_destroy(envid_t envid) {
+  struct Env *e;
+  int r = envid2env(envid, &e, 1);
+  if (r < 0) return r;
+  env_destroy(e);
+  return 0;
+}
+
+// Freeze the current environment as a template for env_clone
+// Does not return to the caller: its clones return 0 from here instead.
+static int sys_env_set_template(void) {
+  env_make_template(curenv);
+  return 0;
+}
+
+// Fork the current environment with a copy-on-write address space
+// Returns the envid of the child to the parent, and 0 to the child.
+// Errors are:
+//   -E_NO_FREE_ENV if all NENV environments are allocated
+//   -E_NO_MEM on memory exhaustion
+static envid_t sys_fork(void) {
+  struct Env *e;
+  int r = env_fork(&e, curenv);
+  if (r < 0) return r;
+  return e->env_id;
+}
+
+// Deschedule current environment and pick a different one to run
+static void sys_yield(void) {
+  sched_yield();
+}
+
+// Block the current environment for 'ns' nanoseconds
+// Returns 0 once the time has passed.
+static int sys_env_sleep(uint64_t ns) {
+  if (!ns) return 0;
+  curenv->env_tf.tf_regs.reg_eax = 0;
+  sched_block(curenv, ns, 0);
+  sched_yield();
+  return 0;
+}
+
+// Set the page fault upcall for 'envid' to 'func'
+// The kernel pushes a fault record onto the exception stack and
+// branches to 'func' when the environment causes a page fault.
+// Returns 0 on success, < 0 on error. Errors are:
+//   -E_BAD_ENV if environment envid doesn't currently exist,
+//     or the caller doesn't have permission to change envid
+static int sys_env_set_pgfault_upcall(envid_t envid, void *func) {
+  struct Env *e;
+  int r = envid2env(envid, &e, 1);
+  if (r < 0) return r;
+  e->env_pgfault_upcall = func;
+  return 0;
+}
+
+// Return true if `va` is a page aligned user address
+static bool user_page_va(void *va) {
+  return (uintptr_t)va < UTOP && PGOFF(va) == 0;
+}
+
+// Return true if `perm` is acceptable for a page mapped by a system call
+// PTE_U | PTE_P must be set, and nothing outside of PTE_SYSCALL.
+static bool user_page_perm(int perm) {
+  return (perm & (PTE_U | PTE_P)) == (PTE_U | PTE_P) &&
+    (perm & ~PTE_SYSCALL) == 0;
+}
+
+// Allocate a zeroed page of memory and map it at 'va' with permission
+// 'perm' in the address space of 'envid'
+// If a page is already mapped at 'va', that page is unmapped.
+// Returns 0 on success, < 0 on error. Errors are:
+//   -E_BAD_ENV if environment envid doesn't currently exist,
+//     or the caller doesn't have permission to change envid
+//   -E_INVAL if va >= UTOP, or va is not page-aligned, or perm is
+//     inappropriate, or writable in a read-only area
+//   -E_NO_MEM if there's no memory to allocate the new page,
+//     or to allocate any necessary page tables
+static int sys_page_alloc(envid_t envid, void *va, int perm) {
+  struct Env *e;
+  int r = envid2env(envid, &e, 1);
+  if (r < 0) return r;
+  if (!user_page_va(va) || !user_page_perm(perm)) return -E_INVAL;
+  if (!vma_allows(e, (uintptr_t)va, perm)) return -E_INVAL;
+  
+  struct PageInfo *pp = page_alloc(ALLOC_ZERO);
+  if (!pp) return -E_NO_MEM;
+  if (page_insert(e->env_pgdir, pp, va, perm) < 0) {
+    page_free(pp);
+    return -E_NO_MEM;
+  }
+  return 0;
+}
+
+// Map the page at 'srcva' in srcenvid's address space at 'dstva' in
+// dstenvid's address space with permission 'perm'
+// Returns 0 on success, < 0 on error. Errors are:
+//   -E_BAD_ENV if srcenvid and/or dstenvid doesn't currently exist,
+//     or the caller doesn't have permission to change one of them
+//   -E_INVAL if srcva or dstva is >= UTOP or not page-aligned,
+//     or srcva is not mapped in srcenvid's address space,
+//     or perm is inappropriate,
+//     or (perm & PTE_W) but srcva is read-only in srcenvid's address space,
+//     or (perm & PTE_W) but dstva is in a read-only area of dstenvid
+//   -E_NO_MEM if there's no memory to allocate any necessary page tables
+static int sys_page_map(envid_t srcenvid, void *srcva,
+    envid_t dstenvid, void *dstva, int perm) {
+  struct Env *src, *dst;
+  int r;
+  if ((r = envid2env(srcenvid, &src, 1)) < 0) return r;
+  if ((r = envid2env(dstenvid, &dst, 1)) < 0) return r;
+  if (!user_page_va(srcva) || !user_page_va(dstva) || !user_page_perm(perm)) {
+    return -E_INVAL;
+  }
+  
+  pte_t *pte;
+  struct PageInfo *pp = page_lookup(src->env_pgdir, srcva, &pte);
+  if (!pp || !(*pte & PTE_U)) return -E_INVAL;
+  // A copy-on-write page is read-only until it is copied
+  if ((perm & PTE_W) && !(*pte & PTE_W)) return -E_INVAL;
+  if (!vma_allows(dst, (uintptr_t)dstva, perm)) return -E_INVAL;
+  return page_insert(dst->env_pgdir, pp, dstva, perm);
+}
+
+// Unmap the page of memory at 'va' in the address space of 'envid'
+// If no page is mapped, the function silently succeeds.
+// Returns 0 on success, < 0 on error. Errors are:
+//   -E_BAD_ENV if environment envid doesn't currently exist,
+//     or the caller doesn't have permission to change envid
+//   -E_INVAL if va >= UTOP, or va is not page-aligned
+//   -E_NO_MEM if the page table is shared with a template or fork, and
+//     there is no memory to copy it
+static int sys_page_unmap(envid_t envid, void *va) {
+  struct Env *e;
+  int r = envid2env(envid, &e, 1);
+  if (r < 0) return r;
+  if (!user_page_va(va)) return -E_INVAL;
+  return page_remove(e->env_pgdir, va);
+}
+
+// Return true if [va, va+len) is a non-empty, page aligned user range
+static bool user_range(void *va, size_t len) {
+  uintptr_t end = (uintptr_t)va + len;
+  return PGOFF(va) == 0 && PGOFF(len) == 0 && len > 0 &&
+    end > (uintptr_t)va && end <= UTOP;
+}
+
+// Declare [va, va+len) in the address space of 'envid' as a demand-zero
+// area: its pages are allocated zeroed and mapped with permission
+// 'perm' when first touched
+// Returns 0 on success, < 0 on error. Errors are:
+//   -E_BAD_ENV if environment envid doesn't currently exist,
+//     or the caller doesn't have permission to change envid
+//   -E_INVAL if the range is not page aligned or goes above UTOP,
+//     or perm is inappropriate, or the range overlaps another area
+//   -E_NO_MEM on memory exhaustion
+static int sys_region_alloc(envid_t envid, void *va, size_t len, int perm) {
+  struct Env *e;
+  int r = envid2env(envid, &e, 1);
+  if (r < 0) return r;
+  if (!user_range(va, len) || !user_page_perm(perm)) return -E_INVAL;
+  return vma_insert(e, (uintptr_t)va, (uintptr_t)va + len, VMA_ZERO,
+      perm & ~PTE_P);
+}
+
+// Unmap [va, va+len) in the address space of 'envid', and remove it
+// from any area
+// Returns 0 on success, < 0 on error. Errors are:
+//   -E_BAD_ENV if environment envid doesn't currently exist,
+//     or the caller doesn't have permission to change envid
+//   -E_INVAL if the range is not page aligned or goes above UTOP
+//   -E_NO_MEM if an area would be split and there is no memory for
+//     another one, or a page table is shared with a template or fork
+//     and there is no memory to copy it; the range stays mapped then
+static int sys_region_free(envid_t envid, void *va, size_t len) {
+  struct Env *e;
+  int r = envid2env(envid, &e, 1);
+  if (r < 0) return r;
+  if (!user_range(va, len)) return -E_INVAL;
+  if ((r = vma_remove(e, (uintptr_t)va, (uintptr_t)va + len)) < 0) return r;
+  return page_remove_range(e->env_pgdir, (uintptr_t)va, (uintptr_t)va + len);
+}
+
+// Open the shared memory object named by the 'namelen' characters at
+// 'name', creating it with 'len' bytes if there is none
+// Returns the id of the object on success, < 0 on error. Errors are:
+//   -E_INVAL if namelen is 0 or not less than SHM_NAMELEN,
+//     and those of shm_open
+// Destroys the environment if it cannot read the name.
+static int sys_shm_open(const char *name, size_t namelen, size_t len) {
+  char buf[SHM_NAMELEN];
+  if (namelen == 0 || namelen >= SHM_NAMELEN) return -E_INVAL;
+  user_mem_assert(curenv, name, namelen, 0);
+  memcpy(buf, name, namelen);
+  buf[namelen] = '\0';
+  if (strlen(buf) != namelen) return -E_INVAL;
+  return shm_open(curenv, buf, len);
+}
+
+// Map the shared memory object 'shmid' at 'va' with permission 'perm'
+// The pages stay shared, rather than becoming copy-on-write, across fork.
+// Returns 0 on success, < 0 on error. Errors are:
+//   -E_INVAL if va is not page-aligned, or perm is inappropriate,
+//     and those of shm_map
+static int sys_shm_map(int shmid, void *va, int perm) {
+  if (!user_page_va(va) || !user_page_perm(perm)) return -E_INVAL;
+  return shm_map(curenv, shmid, (uintptr_t)va, perm);
+}
+
+// Close the shared memory object 'shmid', see shm_close
+static int sys_shm_close(int shmid) {
+  return shm_close(curenv, shmid);
+}
+
+/**** Pages shared with the kernel ****/
+
+// Store in *kva the kernel address of the page at 'va' of 'e', which 'e'
+// shares with the kernel, e.g. for rings or queues
+// The page is faulted in if it is missing, and made private if it is
+// copy-on-write, since the kernel writes it through its own mapping.
+// Returns 0 on success, < 0 on error. Errors are:
+//   -E_FAULT if 'e' cannot write the page
+//   -E_NO_MEM if there's no memory for the page
+static int user_shared_page(struct Env *e, uintptr_t va, void **kva) {
+  pte_t *pte = pgdir_walk(e->env_pgdir, (void*)va, 0);
+  int r = 0;
+  if (!pte || !(*pte & PTE_P)) {
+    r = vma_fault(e, va, FEC_U | FEC_WR);
+  } else if (*pte & PTE_COW) {
+    r = page_copy_on_write(e->env_pgdir, (void*)va);
+  }
+  if (r < 0) return r;
+  
+  struct PageInfo *pp = page_lookup(e->env_pgdir, (void*)va, &pte);
+  if (!pp || (*pte & (PTE_U | PTE_W)) != (PTE_U | PTE_W)) return -E_FAULT;
+  *kva = page2kva(pp);
+  return 0;
+}
+
+/**** Inter-process communication ****/
+
+// Send 'value', and the page at 'srcva' with permission 'perm' if srcva
+// is below UTOP, to 'envid', which must be blocked in sys_ipc_recv
+// The page is mapped in the receiver where it asked for one, without
+// copying, and the receiver is made runnable to return 0 from
+// sys_ipc_recv. The receiver is stored in *e.
+// Returns 0 on success, < 0 on error. Errors are:
+//   -E_BAD_ENV if environment envid doesn't currently exist
+//   -E_IPC_NOT_RECV if envid is not blocked in sys_ipc_recv
+//   -E_INVAL if srcva < UTOP but is not page-aligned or not mapped,
+//     or perm is inappropriate,
+//     or (perm & PTE_W) but srcva is read-only in the caller,
+//     or (perm & PTE_W) but the page would land in a read-only area
+//   -E_NO_MEM if there's no memory to allocate any necessary page tables
+static int ipc_send(envid_t envid, uint32_t value, void *srcva, int perm,
+    struct Env **e) {
+  struct Env *dst;
+  int r = envid2env(envid, &dst, 0);
+  if (r < 0) return r;
+  if (!dst->env_ipc_recving) return -E_IPC_NOT_RECV;
+  
+  dst->env_ipc_perm = 0;
+  if ((uintptr_t)srcva < UTOP) {
+    if (PGOFF(srcva) || !user_page_perm(perm)) return -E_INVAL;
+    pte_t *pte;
+    struct PageInfo *pp = page_lookup(curenv->env_pgdir, srcva, &pte);
+    if (!pp || !(*pte & PTE_U)) return -E_INVAL;
+    if ((perm & PTE_W) && !(*pte & PTE_W)) return -E_INVAL;
+    void *dstva = dst->env_ipc_dstva;
+    if ((uintptr_t)dstva < UTOP) {
+      if (!vma_allows(dst, (uintptr_t)dstva, perm)) return -E_INVAL;
+      if ((r = page_insert(dst->env_pgdir, pp, dstva, perm)) < 0) return r;
+      dst->env_ipc_perm = perm;
+    }
+  }
+  dst->env_ipc_recving = false;
+  dst->env_ipc_from = curenv->env_id;
+  dst->env_ipc_value = value;
+  dst->env_tf.tf_regs.reg_eax = 0;
+  sched_wake(dst);
+  *e = dst;
+  return 0;
+}
+
+// Mark the current environment as blocked receiving at 'dstva', for up
+// to 'timeout_us' microseconds, or without a time limit if it is 0
+static void ipc_wait(void *dstva, uint32_t timeout_us) {
+  curenv->env_ipc_recving = true;
+  curenv->env_ipc_dstva = dstva;
+  sched_block(curenv, timeout_us * 1000ULL, -E_TIMEOUT);
+}
+
+// Try to send 'value', and the page at 'srcva' if srcva < UTOP, to
+// 'envid', see ipc_send
+// On success the receiver runs right away, switched to directly
+// instead of through the scheduler. The caller stays runnable, and
+// returns 0 when it runs again.
+// Returns < 0 on error, with the errors of ipc_send.
+static int sys_ipc_try_send(envid_t envid, uint32_t value, void *srcva,
+    int perm) {
+  struct Env *e;
+  int r = ipc_send(envid, value, srcva, perm, &e);
+  if (r < 0) return r;
+  curenv->env_tf.tf_regs.reg_eax = 0;
+  env_run(e);
+  return 0;
+}
+
+// Block until a message arrives, for up to 'timeout_us' microseconds,
+// or without a time limit if it is 0
+// If 'dstva' < UTOP, a page sent along is mapped there. The message is
+// in the env_ipc_* fields of the caller's struct Env.
+// Returns 0 when a message arrives, < 0 on error. Errors are:
+//   -E_INVAL if dstva < UTOP but is not page-aligned
+//   -E_TIMEOUT if no message arrived in time
+static int sys_ipc_recv(void *dstva, uint32_t timeout_us) {
+  if ((uintptr_t)dstva < UTOP && PGOFF(dstva)) return -E_INVAL;
+  ipc_wait(dstva, timeout_us);
+  sched_yield();
+  return 0;
+}
+
+// Send a message like sys_ipc_try_send, and block receiving at 'dstva'
+// like sys_ipc_recv, with its 'timeout_us', in one system call
+// With it a client calls a server and waits for the reply, and a server
+// replies and waits for the next request. Each message switches
+// directly to an environment that is waiting for it, so that a round
+// trip takes two system calls and no scheduling.
+// Returns 0 when the reply arrives, or < 0 on error, with the errors of
+// ipc_send and of sys_ipc_recv. Nothing is sent on other errors than
+// -E_TIMEOUT.
+static int sys_ipc_call(envid_t envid, uint32_t value, void *srcva, int perm,
+    void *dstva, uint32_t timeout_us) {
+  if ((uintptr_t)dstva < UTOP && PGOFF(dstva)) return -E_INVAL;
+  struct Env *e;
+  int r = ipc_send(envid, value, srcva, perm, &e);
+  if (r < 0) return r;
+  ipc_wait(dstva, timeout_us);
+  env_run(e);
+  return 0;
+}
+
+// Use the page at 'va' as the message queue of the current environment,
+// laid out as a struct MsgQueue, or stop receiving messages if va is 0
+// Returns 0 on success, or -E_INVAL if va is >= UTOP or not page-aligned
+static int sys_mq_setup(void *va) {
+  static_assert(sizeof(struct MsgQueue) <= PGSIZE);
+  if (va && !user_page_va(va)) return -E_INVAL;
+  curenv->env_mq = (uintptr_t)va;
+  return 0;
+}
+
+// Queue 'value' on the message queue of 'envid', without blocking
+// The receiver takes messages off the queue itself. If it is blocked in
+// sys_mq_wait, it is made runnable, but the caller keeps running, so
+// that it can send many messages without a context switch each.
+// Returns 0 on success, < 0 on error. Errors are:
+//   -E_BAD_ENV if environment envid doesn't currently exist
+//   -E_IPC_NOT_RECV if envid has no message queue
+//   -E_QUEUE_FULL if the queue of envid is full
+//   -E_FAULT if envid cannot write the page of its queue
+//   -E_NO_MEM if there's no memory for the page of the queue
+static int sys_mq_send(envid_t envid, uint32_t value) {
+  struct Env *e;
+  int r = envid2env(envid, &e, 0);
+  if (r < 0) return r;
+  if (!e->env_mq) return -E_IPC_NOT_RECV;
+  struct MsgQueue *q;
+  if ((r = user_shared_page(e, e->env_mq, (void**)&q)) < 0) return r;
+  
+  uint32_t tail = q->mq_tail;
+  // mq_head is written by the receiver, and may be anything
+  if (tail - q->mq_head >= MQ_NMSGS) return -E_QUEUE_FULL;
+  q->mq_msgs[tail % MQ_NMSGS] = (struct Msg){
+    .msg_from = curenv->env_id, .msg_value = value,
+  };
+  q->mq_tail = tail + 1;
+  
+  if (e->env_mq_waiting) {
+    e->env_mq_waiting = false;
+    e->env_tf.tf_regs.reg_eax = 0;
+    sched_wake(e);
+  }
+  return 0;
+}
+
+// Block until the message queue of the current environment is not empty,
+// for up to 'timeout_us' microseconds, or without a time limit if it is 0
+// Returns 0 when there is a message, or < 0 on error. Errors are:
+//   -E_INVAL if the environment has no message queue
+//   -E_TIMEOUT if no message arrived in time
+//   and those of user_shared_page for the page of the queue
+static int sys_mq_wait(uint32_t timeout_us) {
+  if (!curenv->env_mq) return -E_INVAL;
+  struct MsgQueue *q;
+  int r = user_shared_page(curenv, curenv->env_mq, (void**)&q);
+  if (r < 0) return r;
+  if (q->mq_head != q->mq_tail) return 0;
+  
+  curenv->env_mq_waiting = true;
+  sched_block(curenv, timeout_us * 1000ULL, -E_TIMEOUT);
+  sched_yield();
+  return 0;
+}
+
+/**** Futexes ****/
+
+// Store in *key the futex of the word at 'addr' of the current
+// environment, and in *val its value
+// Returns 0 on success, < 0 on error. Errors are:
+//   -E_INVAL if addr is >= UTOP or not 4-byte aligned
+//   and those of user_shared_page for the page of the word
+static int futex_lookup(uint32_t *addr, physaddr_t *key, uint32_t *val) {
+  uintptr_t va = (uintptr_t)addr;
+  if (va >= UTOP || va % sizeof(uint32_t)) return -E_INVAL;
+  void *kva;
+  int r = user_shared_page(curenv, ROUNDDOWN(va, PGSIZE), &kva);
+  if (r < 0) return r;
+  *key = PADDR(kva) + PGOFF(va);
+  *val = *(uint32_t*)(kva + PGOFF(va));
+  return 0;
+}
+
+// Block until another environment wakes the futex at 'addr', if it
+// still holds 'expected', for up to 'timeout_us' microseconds, or
+// without a time limit if it is 0
+// Returns 0 once woken, < 0 on error. Errors are:
+//   -E_AGAIN if the word no longer holds 'expected'
+//   -E_TIMEOUT if nobody woke the futex in time
+//   and those of futex_lookup
+static int sys_futex_wait(uint32_t *addr, uint32_t expected,
+    uint32_t timeout_us) {
+  physaddr_t key;
+  uint32_t val;
+  int r = futex_lookup(addr, &key, &val);
+  if (r < 0) return r;
+  if (val != expected) return -E_AGAIN;
+  if ((r = futex_wait(curenv, key)) < 0) return r;
+  
+  curenv->env_tf.tf_regs.reg_eax = 0;
+  sched_block(curenv, timeout_us * 1000ULL, -E_TIMEOUT);
+  sched_yield();
+  return 0;
+}
+
+// Wake up to 'n' environments waiting on the futex at 'addr'
+// Returns the number of environments woken, or < 0 on error,
+// see futex_lookup.
+static int sys_futex_wake(uint32_t *addr, int n) {
+  physaddr_t key;
+  uint32_t val;
+  int r = futex_lookup(addr, &key, &val);
+  if (r < 0) return r;
+  return futex_wake(key, n);
+}
+
+/**** Batched system calls ****/
+
+// Use the page at 'va' as the system call rings of the current
+// environment, laid out as a struct SysRing, or stop using rings if
+// va is 0
+// Returns 0 on success, or -E_INVAL if va is >= UTOP or not page-aligned
+static int sys_ring_setup(void *va) {
+  static_assert(sizeof(struct SysRing) <= PGSIZE);
+  if (va && !user_page_va(va)) return -E_INVAL;
+  curenv->env_sysring = (uintptr_t)va;
+  return 0;
+}
+
+// Store in *ring the system call rings of 'e' at their kernel address
+// Returns 0 on success, or < 0 on error, see user_shared_page.
+static int sysring(struct Env *e, struct SysRing **ring) {
+  if (!e->env_sysring) return -E_INVAL;
+  return user_shared_page(e, e->env_sysring, (void**)ring);
+}
+
+// Return true if system call `num` may be queued on a ring
+// It may not if it does not return to its caller.
+static bool sysring_allows(uint32_t num) {
+  switch (num) {
+  case SYS_env_destroy:
+  case SYS_env_set_template:
+  case SYS_fork:
+  case SYS_yield:
+  case SYS_env_sleep:
+  case SYS_ring_enter:
+  case SYS_ipc_recv:
+  case SYS_ipc_call:
+  case SYS_mq_wait:
+  case SYS_futex_wait:
+    return false;
+  default:
+    return num < NSYSCALLS;
+  }
+}
+
+// Run the system calls queued on the submission ring of the current
+// environment in order, and post their results on the completion ring,
+// until the submission ring is empty or the completion ring is full
+// Many system calls thus take a single entry into the kernel. The ones
+// that may not be queued complete with -E_INVAL. Sent messages do not
+// switch to their receivers, which run when they are scheduled.
+// Returns the number of system calls run, or < 0 on error. Errors are:
+//   -E_INVAL if there are no rings
+//   -E_FAULT if the page of the rings is not writable by the environment
+//   -E_NO_MEM if there's no memory for the page of the rings
+static int sys_ring_enter(void) {
+  struct SysRing *ring;
+  int r = sysring(curenv, &ring);
+  if (r < 0) return r;
+  
+  int n = 0;
+  for (;;) {
+    uint32_t head = ring->sq_head, cq_tail = ring->cq_tail;
+    if (head == ring->sq_tail || ring->sq_tail - head > SYSRING_NSQE ||
+        cq_tail - ring->cq_head >= SYSRING_NCQE) {
+      break;
+    }
+    struct SysSqe sqe = ring->sq[head % SYSRING_NSQE];
+    ring->sq_head = head + 1;
+    
+    const uint32_t *a = sqe.sqe_args;
+    int32_t result = -E_INVAL;
+    struct Env *e;
+    if (sqe.sqe_num == SYS_ipc_try_send) {
+      result = ipc_send(a[0], a[1], (void*)a[2], a[3], &e);
+    } else if (sysring_allows(sqe.sqe_num)) {
+      result = syscall(sqe.sqe_num, a[0], a[1], a[2], a[3], a[4]);
+    }
+    // The rings are looked up again, as the system call may have
+    // unmapped them
+    if (sysring(curenv, &ring) < 0) break;
+    ring->cq[cq_tail % SYSRING_NCQE] = (struct SysCqe){
+      .cqe_result = result, .cqe_data = sqe.sqe_data,
+    };
+    ring->cq_tail = cq_tail + 1;
+    n++;
+  }
+  return n;
+}
+
+// Dispatches to the correct kernel function, passing the arguments
+int32_t syscall(uint32_t num, uint32_t a1, uint32_t a2, uint32_t a3,
+    uint32_t a4, uint32_t a5) {
+  switch (num) {
+  case SYS_cputs:
+    sys_cputs((const char*)a1, a2);
+    return 0;
+  case SYS_cgetc:
+    return sys_cgetc();
+  case SYS_getenvid:
+    return sys_getenvid();
+  case SYS_env_destroy:
+    return sys_env_destroy(a1);
+  case SYS_env_set_template:
+    return sys_env_set_template();
+  case SYS_fork:
+    return sys_fork();
+  case SYS_yield:
+    sys_yield();
+    return 0;
+  case SYS_env_sleep:
+    return sys_env_sleep(a1 | (uint64_t)a2 << 32);
+  case SYS_env_set_pgfault_upcall:
+    return sys_env_set_pgfault_upcall(a1, (void*)a2);
+  case SYS_page_alloc:
+    return sys_page_alloc(a1, (void*)a2, a3);
+  case SYS_page_map:
+    return sys_page_map(a1, (void*)a2, a3, (void*)a4, a5);
+  case SYS_page_unmap:
+    return sys_page_unmap(a1, (void*)a2);
+  case SYS_region_alloc:
+    return sys_region_alloc(a1, (void*)a2, a3, a4);
+  case SYS_region_free:
+    return sys_region_free(a1, (void*)a2, a3);
+  case SYS_ring_setup:
+    return sys_ring_setup((void*)a1);
+  case SYS_ring_enter:
+    return sys_ring_enter();
+  case SYS_ipc_try_send:
+    return sys_ipc_try_send(a1, a2, (void*)a3, a4);
+  case SYS_ipc_recv:
+    return sys_ipc_recv((void*)a1, a2);
+  case SYS_ipc_call:
+    // The page is page-aligned, so its permission fits in the offset
+    return sys_ipc_call(a1, a2, (void*)ROUNDDOWN(a3, PGSIZE), PGOFF(a3),
+        (void*)a4, a5);
+  case SYS_mq_setup:
+    return sys_mq_setup((void*)a1);
+  case SYS_mq_send:
+    return sys_mq_send(a1, a2);
+  case SYS_mq_wait:
+    return sys_mq_wait(a1);
+  case SYS_shm_open:
+    return sys_shm_open((const char*)a1, a2, a3);
+  case SYS_shm_map:
+    return sys_shm_map(a1, (void*)a2, a3);
+  case SYS_shm_close:
+    return sys_shm_close(a1);
+  case SYS_futex_wait:
+    return sys_futex_wait((uint32_t*)a1, a2, a3);
+  case SYS_futex_wake:
+    return sys_futex_wake((uint32_t*)a1, a2);
+  default:
+    return -E_INVAL;
+  }
+}
+
+/**** Benchmarks ****/
+
+// Mapping 10000 pages one system call at a time, and through the rings
+static struct Env *bench_env;
+
+static void bench_run_prog(const char *name) {
+  if (env_create(&bench_env, userprog_lookup(name), ENV_TYPE_USER) < 0) {
+    panic("env_create failed");
+  }
+  env_run_wait(bench_env);
+}
+
+static void bench_page_map_single(void) {
+  bench_run_prog("pagemap");
+}
+BENCH(page_map_single, "syscall/page_map/10000/single", NULL,
+    bench_page_map_single, NULL, 10);
+
+static void bench_page_map_ring(void) {
+  bench_run_prog("pagemapring");
+}
+BENCH(page_map_ring, "syscall/page_map/10000/ring", NULL,
+    bench_page_map_ring, NULL, 10);
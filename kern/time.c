@@ -0,0 +1,178 @@
+#include <kern/time.h>
+#include <inc/x86.h>
+#include <inc/stdio.h>
+#include <inc/trap.h>
+#include <inc/assert.h>
+#include <kern/trap.h>
+#include <kern/picirq.h>
+#include <kern/lapic.h>
+#include <kern/cpu.h>
+
+struct TimeInfo timeinfo;
+
+// Calibration window in PIT counts (10 ms)
+#define CAL_COUNT (TIMER_FREQ / 100)
+#define CAL_TRIES 5
+
+/**** TSC calibration ****/
+
+// Count TSC cycles while PIT counter 2 counts down CAL_COUNT
+// Counter 2 does not interrupt; its output is polled through the PPI.
+static uint64_t pit_measure_tsc(void) {
+  // Enable the gate of counter 2 with the speaker off
+  outb(IO_PPI, (inb(IO_PPI) & ~PPI_SPKR) | PPI_GATE2);
+  
+  outb(TIMER_MODE, TIMER_SEL2 | TIMER_16BIT | TIMER_INTTC);
+  outb(TIMER_CNTR2, CAL_COUNT & 0xFF);
+  outb(TIMER_CNTR2, CAL_COUNT >> 8);
+  
+  // OUT2 goes low on programming and high again on terminal count
+  uint64_t start = read_tsc();
+  while (!(inb(IO_PPI) & PPI_OUT2));
+  uint64_t end = read_tsc();
+  
+  outb(IO_PPI, inb(IO_PPI) & ~PPI_GATE2);
+  return end - start;
+}
+
+// Measure the TSC frequency against the PIT
+// The shortest of several windows is used, since an interruption
+// (e.g. an SMI or the host preempting a VM) only makes a window longer.
+static uint64_t tsc_calibrate(void) {
+  uint64_t best = ~0ULL;
+  for (int i = 0; i < CAL_TRIES; i++) {
+    uint64_t cycles = pit_measure_tsc();
+    if (cycles < best) best = cycles;
+  }
+  return best * TIMER_FREQ / CAL_COUNT;
+}
+
+// Choose mult and shift so that (cycles * mult) >> shift is in nanoseconds,
+// keeping mult within 32 bits with as much precision as possible
+static void time_set_factors(uint64_t tsc_hz) {
+  uint32_t shift = 32;
+  uint64_t mult;
+  while ((mult = (1000000000ULL << shift) / tsc_hz) > 0xFFFFFFFFULL) shift--;
+  timeinfo.tsc_hz = tsc_hz;
+  timeinfo.mult = mult;
+  timeinfo.shift = shift;
+}
+
+/**** Clock API ****/
+
+// Convert TSC cycles to nanoseconds
+// The multiplication is split into 32-bit halves to avoid overflowing
+// 64 bits and to keep it to a few instructions on i386.
+uint64_t cycles_to_ns(uint64_t cycles) {
+  uint32_t hi = cycles >> 32, lo = cycles;
+  uint64_t ns = ((uint64_t) lo * timeinfo.mult) >> timeinfo.shift;
+  if (hi) ns += ((uint64_t) hi * timeinfo.mult) << (32 - timeinfo.shift);
+  return ns;
+}
+
+// Convert nanoseconds to TSC cycles
+// Whole seconds are converted separately so that the product cannot overflow
+// Times too long to count in 64 bits of cycles become NO_DEADLINE.
+uint64_t ns_to_cycles(uint64_t ns) {
+  uint64_t sec = ns / 1000000000ULL, rem = ns % 1000000000ULL;
+  if (sec > NO_DEADLINE / timeinfo.tsc_hz) return NO_DEADLINE;
+  uint64_t cycles = sec * timeinfo.tsc_hz;
+  return time_add(cycles, rem * timeinfo.tsc_hz / 1000000000ULL);
+}
+
+// Return the monotonic TSC cycles since time_init
+uint64_t time_cycles(void) {
+  return read_tsc() - timeinfo.tsc_base;
+}
+
+// Return the monotonic nanoseconds since time_init
+uint64_t time_ns(void) {
+  return cycles_to_ns(time_cycles());
+}
+
+/**** Timer interrupts ****/
+
+// The timer is one-shot: it is armed only for the earliest pending
+// deadline, so an idle CPU with nothing pending takes no interrupts.
+// Without a local APIC the PIT ticks periodically and each tick
+// checks the deadline instead.
+static uint64_t time_deadline = NO_DEADLINE;
+static time_handler_t time_handler;
+
+// Set the function called when the deadline passes
+void time_set_handler(time_handler_t handler) {
+  time_handler = handler;
+}
+
+// Arrange for the handler to be called once time_cycles() reaches
+// `deadline`, replacing any earlier request
+// NO_DEADLINE stops the timer.
+void time_set_deadline(uint64_t deadline) {
+  time_deadline = deadline;
+  if (!lapic) return;
+  if (deadline == NO_DEADLINE) {
+    lapic_timer_stop();
+  } else {
+    lapic_timer_arm(time_add(timeinfo.tsc_base, deadline));
+  }
+}
+
+static void timer_irq(struct Trapframe *tf) {
+  thiscpu->timer_irqs++;
+  if (lapic) {
+    lapic_eoi();
+  } else {
+    irq_eoi(IRQ_TIMER);
+  }
+  
+  if (time_deadline == NO_DEADLINE) return;
+  uint64_t now = time_cycles();
+  if (now < time_deadline) {
+    // The APIC timer could not count up to a far deadline
+    if (lapic) lapic_timer_arm(time_add(timeinfo.tsc_base, time_deadline));
+    return;
+  }
+  time_deadline = NO_DEADLINE;
+  if (time_handler) time_handler(now);
+}
+
+// Program PIT counter 0 to interrupt HZ times a second
+static void pit_tick_init(void) {
+  uint32_t count = (TIMER_FREQ + HZ / 2) / HZ;
+  outb(TIMER_MODE, TIMER_SEL0 | TIMER_16BIT | TIMER_RATEGEN);
+  outb(TIMER_CNTR0, count & 0xFF);
+  outb(TIMER_CNTR0, count >> 8);
+  irq_enable(IRQ_TIMER);
+}
+
+// Halt the CPU until the next interrupt
+// Must be called with interrupts disabled, and returns with them disabled.
+// The time spent halted is accounted as idle residency of this CPU.
+void cpu_idle(void) {
+  struct CpuInfo *c = thiscpu;
+  uint64_t start = read_tsc();
+  // sti takes effect only after hlt has started, so an interrupt
+  // that became pending before still wakes up hlt
+  asm volatile("sti; hlt; cli" : : : "memory");
+  c->idle_cycles += read_tsc() - start;
+  c->idle_entries++;
+}
+
+// Initialize timekeeping
+// Must be called after mem_init and pic_init
+void time_init(void) {
+  uint32_t edx;
+  cpuid(1, NULL, NULL, NULL, &edx);
+  if (!(edx & (1 << 4))) panic("time_init: no TSC");
+  
+  time_set_factors(tsc_calibrate());
+  timeinfo.tsc_base = read_tsc();
+  
+  trap_register(IRQ_OFFSET + IRQ_TIMER, timer_irq);
+  lapic_init();
+  if (!lapic) pit_tick_init();
+  
+  uint32_t khz = timeinfo.tsc_hz / 1000;
+  cprintf("TSC: %u.%03u MHz, ns = cycles * %u >> %u\n",
+    khz / 1000, khz % 1000, timeinfo.mult, timeinfo.shift);
+}
@@ -0,0 +1,55 @@
+#ifndef KERN_TIME_H
+#define KERN_TIME_H
+
+#include <inc/types.h>
+
+// I/O ports of the 8253/8254 programmable interval timer (PIT)
+#define IO_TIMER1 0x040 // 8253 Timer #1
+#define TIMER_CNTR0 (IO_TIMER1 + 0) // Counter 0, wired to IRQ 0
+#define TIMER_CNTR2 (IO_TIMER1 + 2) // Counter 2, gated by IO_PPI
+#define TIMER_MODE (IO_TIMER1 + 3) // Mode/command register
+#define   TIMER_SEL0 0x00 //   Select counter 0
+#define   TIMER_SEL2 0x80 //   Select counter 2
+#define   TIMER_INTTC 0x00 //   Mode 0: interrupt on terminal count
+#define   TIMER_RATEGEN 0x04 //   Mode 2: rate generator
+#define   TIMER_16BIT 0x30 //   Read/write counter 16 bits, LSB first
+#define TIMER_FREQ 1193182 // Input frequency of the PIT in Hz
+
+// Port B of the 8255 PPI, which gates PIT counter 2
+#define IO_PPI 0x061
+#define   PPI_GATE2 0x01 //   Gate input of counter 2
+#define   PPI_SPKR 0x02 //   Connect counter 2 to the speaker
+#define   PPI_OUT2 0x20 //   Output of counter 2
+
+#define HZ 100 // Frequency of the PIT tick used without a local APIC
+
+#define NO_DEADLINE (~0ULL)
+
+// Conversion factors between TSC cycles and time, set by time_init
+// ns = (cycles * mult) >> shift
+struct TimeInfo {
+  uint64_t tsc_hz; // TSC frequency
+  uint32_t mult;
+  uint32_t shift;
+  uint64_t tsc_base; // TSC value at time 0
+};
+
+extern struct TimeInfo timeinfo;
+
+typedef void (*time_handler_t)(uint64_t now);
+
+void time_init(void);
+uint64_t cycles_to_ns(uint64_t cycles);
+uint64_t ns_to_cycles(uint64_t ns);
+uint64_t time_cycles(void);
+uint64_t time_ns(void);
+void time_set_handler(time_handler_t handler);
+void time_set_deadline(uint64_t deadline);
+void cpu_idle(void);
+
+// Add times in cycles, saturating at NO_DEADLINE
+static inline uint64_t time_add(uint64_t a, uint64_t b) {
+  return a > NO_DEADLINE - b ? NO_DEADLINE : a + b;
+}
+
+#endif // KERN_TIME_H
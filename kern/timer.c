@@ -0,0 +1,305 @@
+// Hierarchical timing wheel
+//
+// Time is divided into jiffies of 2**wheel_shift TSC cycles (0.5-1 ms).
+// Level 0 has a bucket per jiffy for the next TVR_SIZE jiffies, and each
+// further level has TVN_SIZE buckets that each cover a whole turn of the
+// level below. Inserting and cancelling a timer are O(1). When level 0
+// wraps around, the current bucket of level 1 is cascaded, i.e. its
+// timers are re-inserted into level 0, and so on for higher levels.
+// A bitmap of non-empty buckets lets empty stretches be skipped, which
+// matters because the timer interrupt is one-shot and the wheel may
+// not have been advanced for a long time.
+#include <kern/timer.h>
+#include <inc/assert.h>
+#include <kern/time.h>
+#include <kern/bench.h>
+
+#define TVR_BITS 8
+#define TVN_BITS 6
+#define TVR_SIZE (1 << TVR_BITS)
+#define TVN_SIZE (1 << TVN_BITS)
+#define TVR_MASK (TVR_SIZE - 1)
+#define TVN_MASK (TVN_SIZE - 1)
+#define NLEVELS 4
+#define NSLOTS (TVR_SIZE + (NLEVELS - 1) * TVN_SIZE)
+#define NO_SLOT 0xFFFF
+
+// Timers further away than this are parked in the last bucket reachable
+// and re-inserted when it is cascaded
+#define MAX_DELTA ((1ULL << (TVR_BITS + (NLEVELS - 1) * TVN_BITS)) - 1)
+
+// Target length of a jiffy
+#define JIFFIES_PER_SEC 1000
+
+// First bucket of each level
+static const uint16_t level_base[NLEVELS] = {
+  0, TVR_SIZE, TVR_SIZE + TVN_SIZE, TVR_SIZE + 2 * TVN_SIZE,
+};
+
+static struct {
+  struct Timer *buckets[NSLOTS];
+  uint32_t bitmap[NSLOTS / 32]; // Non-empty buckets
+  uint64_t clk; // Next jiffy to process
+  uint64_t programmed; // Jiffy the timer interrupt is armed for
+  uint32_t npending;
+} wheel;
+
+static uint32_t wheel_shift;
+
+static inline uint64_t cycles_to_jiffies(uint64_t cycles) {
+  return cycles >> wheel_shift;
+}
+
+// Index within level `level` (>= 1) of jiffy `j`
+static inline int level_index(uint64_t j, int level) {
+  return (j >> (TVR_BITS + (level - 1) * TVN_BITS)) & TVN_MASK;
+}
+
+/**** Buckets ****/
+
+static void bucket_link(struct Timer *t, int slot) {
+  struct Timer **head = &wheel.buckets[slot];
+  t->next = *head;
+  if (t->next) t->next->pprev = &t->next;
+  t->pprev = head;
+  *head = t;
+  t->slot = slot;
+  wheel.bitmap[slot / 32] |= 1 << (slot % 32);
+}
+
+static void timer_unlink(struct Timer *t) {
+  *t->pprev = t->next;
+  if (t->next) t->next->pprev = t->pprev;
+  if (t->slot != NO_SLOT && !wheel.buckets[t->slot]) {
+    wheel.bitmap[t->slot / 32] &= ~(1 << (t->slot % 32));
+  }
+  t->next = NULL;
+  t->pprev = NULL;
+}
+
+// Return the first non-empty bucket in [from, to), or -1
+static int bucket_find(int from, int to) {
+  while (from < to) {
+    uint32_t word = wheel.bitmap[from / 32] >> (from % 32);
+    if (word) {
+      from += __builtin_ctz(word);
+      return from < to ? from : -1;
+    }
+    from = ROUNDDOWN(from, 32) + 32;
+  }
+  return -1;
+}
+
+// Move the whole bucket `slot` to the list `*list`
+// The timers keep working with timer_unlink while on the list.
+static void bucket_detach(int slot, struct Timer **list) {
+  *list = wheel.buckets[slot];
+  wheel.buckets[slot] = NULL;
+  wheel.bitmap[slot / 32] &= ~(1 << (slot % 32));
+  if (*list) (*list)->pprev = list;
+  for (struct Timer *t = *list; t; t = t->next) t->slot = NO_SLOT;
+}
+
+/**** The wheel ****/
+
+static void wheel_insert(struct Timer *t) {
+  // Overdue timers go to the current bucket
+  uint64_t e = MAX(t->expires, wheel.clk);
+  uint64_t delta = e - wheel.clk;
+  if (delta < TVR_SIZE) {
+    bucket_link(t, e & TVR_MASK);
+    return;
+  }
+  if (delta > MAX_DELTA) e = wheel.clk + MAX_DELTA;
+  int level = 1;
+  while (e - wheel.clk >= 1ULL << (TVR_BITS + level * TVN_BITS)) level++;
+  bucket_link(t, level_base[level] + level_index(e, level));
+}
+
+// Re-insert the current bucket of `level` into the levels below
+// Returns the index of that bucket.
+static int cascade(int level) {
+  int index = level_index(wheel.clk, level);
+  struct Timer *list;
+  bucket_detach(level_base[level] + index, &list);
+  while (list) {
+    struct Timer *t = list;
+    timer_unlink(t);
+    wheel_insert(t);
+  }
+  return index;
+}
+
+// Return the earliest expiry in bucket `index` of `level`
+// Timers parked in the last level beyond the range of the wheel expire
+// later than their bucket is cascaded. The end of the bucket's span is
+// returned for them instead, so that the wheel is advanced past the
+// cascade in time.
+static uint64_t bucket_next(int level, int index) {
+  uint64_t min = NO_DEADLINE;
+  int slot = level_base[level] + index;
+  for (struct Timer *t = wheel.buckets[slot]; t; t = t->next) {
+    min = MIN(min, t->expires);
+  }
+  if (level == NLEVELS - 1 && min != NO_DEADLINE) {
+    int shift = TVR_BITS + (level - 1) * TVN_BITS;
+    uint64_t turn = 1ULL << (shift + TVN_BITS);
+    uint64_t start = (wheel.clk & ~(turn - 1)) + ((uint64_t)index << shift);
+    if (start < wheel.clk) start += turn;
+    min = MIN(min, start + (1ULL << shift));
+  }
+  return min;
+}
+
+// Return the jiffy of the earliest pending timer, or NO_DEADLINE
+// Within a level, buckets after the current one are in expiry order;
+// the current bucket itself holds either the nearest timers (not yet
+// cascaded) or, after a full turn, the farthest, so it is checked too.
+static uint64_t wheel_next(void) {
+  if (wheel.npending == 0) return NO_DEADLINE;
+  uint64_t next = NO_DEADLINE;
+  for (int level = 0; level < NLEVELS; level++) {
+    int size = level == 0 ? TVR_SIZE : TVN_SIZE;
+    int base = level_base[level];
+    int cur = level == 0 ? wheel.clk & TVR_MASK : level_index(wheel.clk, level);
+    int slot = bucket_find(base + cur + 1, base + size);
+    if (slot < 0) slot = bucket_find(base, base + cur);
+    if (slot >= 0) next = MIN(next, bucket_next(level, slot - base));
+    next = MIN(next, bucket_next(level, cur));
+  }
+  return next;
+}
+
+// Arm the timer interrupt for the earliest pending timer
+static void wheel_program(void) {
+  wheel.programmed = wheel_next();
+  if (wheel.programmed == NO_DEADLINE) {
+    time_set_deadline(NO_DEADLINE);
+  } else {
+    time_set_deadline(wheel.programmed << wheel_shift);
+  }
+}
+
+// Run the timers that expired by time_cycles() `now`
+// Called from the timer interrupt
+static void timer_run(uint64_t now) {
+  uint64_t now_j = cycles_to_jiffies(now);
+  while (wheel.clk <= now_j) {
+    if (wheel.npending == 0) {
+      wheel.clk = now_j + 1;
+      break;
+    }
+    int index = wheel.clk & TVR_MASK;
+    if (index == 0 && cascade(1) == 0 && cascade(2) == 0) cascade(3);
+    
+    // Skip to the next non-empty bucket, or to the end of this turn
+    // of level 0 if nothing is due in it
+    int slot = bucket_find(index, TVR_SIZE);
+    if (slot < 0) {
+      wheel.clk = MIN((wheel.clk | TVR_MASK) + 1, now_j + 1);
+      continue;
+    }
+    // The wheel must not run ahead of time, or timers added later
+    // for the skipped jiffies would be taken as overdue
+    if (wheel.clk + (slot - index) > now_j) {
+      wheel.clk = now_j + 1;
+      break;
+    }
+    wheel.clk += slot - index;
+    
+    struct Timer *list;
+    bucket_detach(slot, &list);
+    wheel.clk++;
+    while (list) {
+      struct Timer *t = list;
+      timer_unlink(t);
+      wheel.npending--;
+      t->fn(t);
+    }
+  }
+  wheel_program();
+}
+
+/**** Timer API ****/
+
+void timer_wheel_init(void) {
+  wheel_shift = 0;
+  while ((2ULL << wheel_shift) <= timeinfo.tsc_hz / JIFFIES_PER_SEC) {
+    wheel_shift++;
+  }
+  wheel.clk = cycles_to_jiffies(time_cycles());
+  wheel.programmed = NO_DEADLINE;
+  time_set_handler(timer_run);
+}
+
+void timer_setup(struct Timer *t, timer_fn_t fn, void *arg) {
+  t->next = NULL;
+  t->pprev = NULL;
+  t->slot = NO_SLOT;
+  t->fn = fn;
+  t->arg = arg;
+}
+
+// Arm `t` to expire once time_cycles() reaches `deadline`
+// A pending timer is moved to the new deadline.
+void timer_add(struct Timer *t, uint64_t deadline) {
+  timer_cancel(t);
+  // Round up so that timers never expire early
+  t->expires = cycles_to_jiffies(time_add(deadline, (1ULL << wheel_shift) - 1));
+  wheel_insert(t);
+  wheel.npending++;
+  if (t->expires < wheel.programmed) {
+    wheel.programmed = t->expires;
+    time_set_deadline(t->expires << wheel_shift);
+  }
+}
+
+// Arm `t` to expire `delay_ns` nanoseconds from now
+// Delays beyond the range of the clock never expire.
+void timer_add_ns(struct Timer *t, uint64_t delay_ns) {
+  timer_add(t, time_add(time_cycles(), ns_to_cycles(delay_ns)));
+}
+
+// Disarm `t`, returning whether it was pending
+// The timer interrupt stays armed; if `t` was the earliest timer,
+// the interrupt finds nothing due and re-arms for the next one.
+bool timer_cancel(struct Timer *t) {
+  if (!timer_pending(t)) return false;
+  timer_unlink(t);
+  wheel.npending--;
+  return true;
+}
+
+uint32_t timer_npending(void) {
+  return wheel.npending;
+}
+
+/**** Benchmarks ****/
+
+#define BENCH_NTIMERS 64
+
+static struct Timer bench_timers[BENCH_NTIMERS];
+
+static void bench_timer_nop(struct Timer *t) {}
+
+static void bench_timer_setup(void) {
+  for (int i = 0; i < BENCH_NTIMERS; i++) {
+    timer_setup(&bench_timers[i], bench_timer_nop, NULL);
+  }
+}
+
+static void bench_timer_teardown(void) {
+  for (int i = 0; i < BENCH_NTIMERS; i++) timer_cancel(&bench_timers[i]);
+}
+
+// Arm and cancel a batch of timeouts spread over 1 ms to 1 min
+static void bench_timer_add_cancel(void) {
+  uint64_t now = time_cycles();
+  uint64_t step = timeinfo.tsc_hz / 1000;
+  for (int i = 0; i < BENCH_NTIMERS; i++) {
+    timer_add(&bench_timers[i], now + step * (1 + i * i * 15));
+  }
+  for (int i = 0; i < BENCH_NTIMERS; i++) timer_cancel(&bench_timers[i]);
+}
+BENCH(timer_add_cancel, "timer/add+cancel/64", bench_timer_setup,
+    bench_timer_add_cancel, bench_timer_teardown, 0);
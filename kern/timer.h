@@ -0,0 +1,33 @@
+#ifndef KERN_TIMER_H
+#define KERN_TIMER_H
+
+#include <inc/types.h>
+
+struct Timer;
+typedef void (*timer_fn_t)(struct Timer *t);
+
+// A one-shot software timer
+// Initialize with timer_setup, then arm with timer_add or timer_add_ns.
+// The callback runs from the timer interrupt, after the timer has been
+// removed from the wheel, so it may re-arm the timer.
+struct Timer {
+  struct Timer *next;
+  struct Timer **pprev; // NULL if the timer is not pending
+  uint64_t expires; // Expiry in wheel jiffies
+  uint16_t slot; // Bucket the timer is in
+  timer_fn_t fn;
+  void *arg; // For use by `fn`
+};
+
+void timer_wheel_init(void);
+void timer_setup(struct Timer *t, timer_fn_t fn, void *arg);
+void timer_add(struct Timer *t, uint64_t deadline);
+void timer_add_ns(struct Timer *t, uint64_t delay_ns);
+bool timer_cancel(struct Timer *t);
+uint32_t timer_npending(void);
+
+static inline bool timer_pending(const struct Timer *t) {
+  return t->pprev != NULL;
+}
+
+#endif // KERN_TIMER_H
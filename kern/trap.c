@@ -0,0 +1,402 @@
+#include <kern/trap.h>
+#include <inc/mmu.h>
+#include <inc/x86.h>
+#include <inc/assert.h>
+#include <inc/error.h>
+#include <inc/string.h>
+#include <inc/memlayout.h>
+
+#include <kern/env.h>
+#include <kern/pmap.h>
+#include <kern/vma.h>
+#include <kern/monitor.h>
+#include <kern/syscall.h>
+#include <kern/bench.h>
+
+static struct Taskstate ts;
+
+// Interrupt descriptor table
+// It is built at run time from trap_vectors in kern/trapentry.S
+struct Gatedesc idt[NVECTORS] = { { 0 } };
+struct Pseudodesc idt_pd = {
+  sizeof(idt) - 1, (uint32_t) idt
+};
+
+// Trap handlers keyed by vector
+static trap_handler_t trap_handlers[NVECTORS];
+struct TrapStat trap_stats[NVECTORS];
+
+const char *trapname(int trapno) {
+  static const char * const excnames[] = {
+    "Divide error",
+    "Debug",
+    "Non-Maskable Interrupt",
+    "Breakpoint",
+    "Overflow",
+    "BOUND Range Exceeded",
+    "Invalid Opcode",
+    "Device Not Available",
+    "Double Fault",
+    "Coprocessor Segment Overrun",
+    "Invalid TSS",
+    "Segment Not Present",
+    "Stack Fault",
+    "General Protection",
+    "Page Fault",
+    "(unknown trap)",
+    "x87 FPU Floating-Point Error",
+    "Alignment Check",
+    "Machine-Check",
+    "SIMD Floating-Point Exception"
+  };
+  
+  if (trapno < ARRAY_SIZE(excnames)) return excnames[trapno];
+  if (trapno == T_SYSCALL) return "System call";
+  if (trapno >= IRQ_OFFSET && trapno < IRQ_OFFSET + 16) {
+    return "Hardware Interrupt";
+  }
+  return "(unknown trap)";
+}
+
+static void trap_brkpt(struct Trapframe *tf) {
+  monitor(tf);
+}
+
+static void trap_syscall(struct Trapframe *tf) {
+  struct PushRegs *regs = &tf->tf_regs;
+  regs->reg_eax = syscall(regs->reg_eax, regs->reg_edx, regs->reg_ecx,
+      regs->reg_ebx, regs->reg_edi, regs->reg_esi);
+}
+
+/**** Fast system calls ****/
+
+#define CPUID_SEP (1 << 11) // CPUID.1:EDX
+#define MSR_SYSENTER_CS 0x174
+#define MSR_SYSENTER_ESP 0x175
+#define MSR_SYSENTER_EIP 0x176
+
+// In kern/trapentry.S
+extern char syscall_stub_int[], syscall_stub_int_end[];
+extern char syscall_stub_sysenter[], syscall_stub_sysenter_ret[];
+extern char syscall_stub_sysenter_end[];
+void sysenter_entry(void);
+
+// System calls enter with sysenter, rather than with T_SYSCALL
+static bool use_sysenter;
+
+// Map the system call stub at USYSCALL, read-only for users
+// Environments share the page through the kernel part of their page
+// directories. It enters the kernel with sysenter if the CPU has it,
+// or with T_SYSCALL.
+static void syscall_page_init(void) {
+  uint32_t eax, edx;
+  cpuid(1, &eax, NULL, NULL, &edx);
+  uint32_t family = (eax >> 8) & 0xF, model = (eax >> 4) & 0xF;
+  // Early Pentium Pros report SEP without supporting it
+  use_sysenter = (edx & CPUID_SEP) &&
+    !(family == 6 && model < 3 && (eax & 0xF) < 3);
+  
+  const char *stub = use_sysenter ? syscall_stub_sysenter : syscall_stub_int;
+  const char *end = use_sysenter ?
+    syscall_stub_sysenter_end : syscall_stub_int_end;
+  struct PageInfo *pp = page_alloc(ALLOC_ZERO);
+  if (!pp || page_insert(kern_pgdir, pp, (void*)USYSCALL, PTE_U) < 0) {
+    panic("syscall_page_init: out of memory");
+  }
+  memcpy(page2kva(pp), stub, end - stub);
+}
+
+// Called from sysenter_entry in kern/trapentry.S with the system call
+// number, the arguments passed in registers, and the user %esp, where
+// the stub pushed %ebp, %edx and %ecx
+// curenv->env_tf is filled in as if the environment trapped at the
+// return address of the stub, for system calls that do not return
+// here, e.g. because they run another environment.
+int32_t sysenter_syscall(uint32_t num, uint32_t a3, uint32_t a4, uint32_t a5,
+    uintptr_t esp) {
+  struct Trapframe *tf = &curenv->env_tf;
+  tf->tf_regs.reg_eax = num;
+  tf->tf_regs.reg_ebx = a3;
+  tf->tf_regs.reg_edi = a4;
+  tf->tf_regs.reg_esi = a5;
+  tf->tf_regs.reg_ebp = esp;
+  tf->tf_trapno = T_SYSCALL;
+  tf->tf_eip = USYSCALL + (syscall_stub_sysenter_ret - syscall_stub_sysenter);
+  tf->tf_esp = esp;
+  tf->tf_eflags = read_eflags() | FL_IF;
+  tf->tf_cs = GD_UT | 3;
+  tf->tf_ss = tf->tf_ds = tf->tf_es = GD_UD | 3;
+  
+  // Destroys the environment if it entered without the stub's stack
+  user_mem_assert(curenv, (void*)esp, 3 * sizeof(uint32_t), PTE_U);
+  const uint32_t *args = (const uint32_t*)esp;
+  tf->tf_regs.reg_edx = args[1];
+  tf->tf_regs.reg_ecx = args[2];
+  
+  tf->tf_regs.reg_eax = syscall(num, args[1], args[2], a3, a4, a5);
+  return tf->tf_regs.reg_eax;
+}
+
+// Make the current environment handle its page fault at `fault_va`
+// A UTrapframe is pushed on the user exception stack, and the
+// environment resumes at its upcall. The upcall returns to the faulting
+// instruction by itself, without entering the kernel again: see
+// lib/pfentry.S. A fault during the upcall pushes a nested UTrapframe
+// below the current one, leaving a word for the upcall to return with.
+static void page_fault_upcall(struct Trapframe *tf, uint32_t fault_va) {
+  uintptr_t top = UXSTACKTOP;
+  if (tf->tf_esp >= UXSTACKTOP - PGSIZE && tf->tf_esp < UXSTACKTOP) {
+    top = tf->tf_esp - 4;
+  }
+  struct UTrapframe *utf = (struct UTrapframe*)(top - sizeof(*utf));
+  
+  // The exception stack is copy-on-write after a fork
+  for (uintptr_t va = ROUNDDOWN((uintptr_t)utf, PGSIZE); va < top;
+      va += PGSIZE) {
+    int r = page_copy_on_write(curenv->env_pgdir, (void*)va);
+    if (r < 0 && r != -E_FAULT) {
+      cprintf("[%08x] copy-on-write: %e\n", curenv->env_id, r);
+      env_destroy(curenv);
+    }
+  }
+  // Destroys the environment if the exception stack is missing or
+  // overflowed
+  user_mem_assert(curenv, utf, sizeof(*utf), PTE_W);
+  
+  utf->utf_fault_va = fault_va;
+  utf->utf_err = tf->tf_err;
+  utf->utf_regs = tf->tf_regs;
+  utf->utf_eip = tf->tf_eip;
+  utf->utf_eflags = tf->tf_eflags;
+  utf->utf_esp = tf->tf_esp;
+  
+  tf->tf_eip = (uintptr_t)curenv->env_pgfault_upcall;
+  tf->tf_esp = (uintptr_t)utf;
+}
+
+static void page_fault_handler(struct Trapframe *tf) {
+  // Read processor's CR2 register to find the faulting address
+  uint32_t fault_va = rcr2();
+  
+  // Page faults in kernel mode are bugs
+  if ((tf->tf_cs & 3) == 0) {
+    print_trapframe(tf);
+    panic("kernel page fault at va %08x", fault_va);
+  }
+  
+  curenv->env_pgfaults++;
+  
+  // Writes to copy-on-write pages get a private copy of the page
+  int r = -E_FAULT;
+  if ((tf->tf_err & (FEC_PR | FEC_WR)) == (FEC_PR | FEC_WR)) {
+    r = page_copy_on_write(curenv->env_pgdir, (void*)fault_va);
+  } else if (!(tf->tf_err & FEC_PR)) {
+    // Missing pages of an area are mapped on demand
+    r = vma_fault(curenv, fault_va, tf->tf_err);
+  }
+  if (r == 0) return;
+  if (r != -E_FAULT) {
+    cprintf("[%08x] page fault: %e\n", curenv->env_id, r);
+    env_destroy(curenv);
+  }
+  
+  if (curenv->env_pgfault_upcall) {
+    page_fault_upcall(tf, fault_va);
+    return;
+  }
+  
+  // Destroy the environment that caused the fault
+  cprintf("[%08x] user fault va %08x ip %08x\n",
+      curenv->env_id, fault_va, tf->tf_eip);
+  print_trapframe(tf);
+  env_destroy(curenv);
+}
+
+void trap_init(void) {
+  // Pairs of a trap number and its entry point in kern/trapentry.S
+  extern struct {
+    uint32_t trapno;
+    void (*entry)(void);
+  } trap_vectors[], trap_vectors_end[];
+  
+  for (typeof(&trap_vectors[0]) v = trap_vectors; v < trap_vectors_end; v++) {
+    // Breakpoints and system calls can be raised from user mode
+    int dpl = (v->trapno == T_BRKPT || v->trapno == T_SYSCALL) ? 3 : 0;
+    SETGATE(idt[v->trapno], 0, GD_KT, v->entry, dpl);
+  }
+  
+  trap_register(T_BRKPT, trap_brkpt);
+  trap_register(T_SYSCALL, trap_syscall);
+  trap_register(T_PGFLT, page_fault_handler);
+  syscall_page_init();
+  
+  // Per-CPU setup
+  trap_init_percpu();
+}
+
+// Initialize and load the per-CPU TSS and IDT
+void trap_init_percpu(void) {
+  // Setup a TSS so that we get the right stack
+  // when we trap to the kernel
+  ts.ts_esp0 = KSTACKTOP;
+  ts.ts_ss0 = GD_KD;
+  ts.ts_iomb = sizeof(struct Taskstate);
+  
+  // Initialize the TSS slot of the gdt
+  gdt[GD_TSS0 >> 3] = SEG16(STS_T32A, (uint32_t) (&ts),
+      sizeof(struct Taskstate) - 1, 0);
+  gdt[GD_TSS0 >> 3].sd_s = 0;
+  
+  // Load the TSS selector
+  // (like other segment selectors, the bottom three bits are special)
+  ltr(GD_TSS0);
+  
+  // Load the IDT
+  lidt(&idt_pd);
+  
+  // sysenter takes the same stack as traps
+  if (use_sysenter) {
+    wrmsr(MSR_SYSENTER_CS, GD_KT);
+    wrmsr(MSR_SYSENTER_ESP, ts.ts_esp0);
+    wrmsr(MSR_SYSENTER_EIP, (uintptr_t)sysenter_entry);
+  }
+}
+
+// Set the stack that traps from user mode are taken on
+void trap_set_kstack(uintptr_t esp) {
+  ts.ts_esp0 = esp;
+  if (use_sysenter) wrmsr(MSR_SYSENTER_ESP, esp);
+}
+
+trap_handler_t trap_register(int trapno, trap_handler_t handler) {
+  assert(trapno >= 0 && trapno < NVECTORS);
+  trap_handler_t old = trap_handlers[trapno];
+  trap_handlers[trapno] = handler;
+  return old;
+}
+
+void print_trapframe(struct Trapframe *tf) {
+  cprintf("TRAP frame at %p\n", tf);
+  print_regs(&tf->tf_regs);
+  cprintf("  es   0x----%04x\n", tf->tf_es);
+  cprintf("  ds   0x----%04x\n", tf->tf_ds);
+  cprintf("  trap 0x%08x %s\n", tf->tf_trapno, trapname(tf->tf_trapno));
+  // If this trap was a page fault, print the faulting linear address
+  if (tf->tf_trapno == T_PGFLT) cprintf("  cr2  0x%08x\n", rcr2());
+  cprintf("  err  0x%08x", tf->tf_err);
+  // For page faults, print decoded fault error code:
+  // U/K=fault occurred in user/kernel mode
+  // W/R=a write/read caused the fault
+  // PR=a protection violation caused the fault (NP=page not present).
+  if (tf->tf_trapno == T_PGFLT) {
+    cprintf(" [%s, %s, %s]\n",
+        tf->tf_err & FEC_U ? "user" : "kernel",
+        tf->tf_err & FEC_WR ? "write" : "read",
+        tf->tf_err & FEC_PR ? "protection" : "not-present");
+  } else {
+    cprintf("\n");
+  }
+  cprintf("  eip  0x%08x\n", tf->tf_eip);
+  cprintf("  cs   0x----%04x\n", tf->tf_cs);
+  cprintf("  flag 0x%08x\n", tf->tf_eflags);
+  if ((tf->tf_cs & 3) != 0) {
+    cprintf("  esp  0x%08x\n", tf->tf_esp);
+    cprintf("  ss   0x----%04x\n", tf->tf_ss);
+  }
+}
+
+void print_regs(struct PushRegs *regs) {
+  cprintf("  edi  0x%08x\n", regs->reg_edi);
+  cprintf("  esi  0x%08x\n", regs->reg_esi);
+  cprintf("  ebp  0x%08x\n", regs->reg_ebp);
+  cprintf("  oesp 0x%08x\n", regs->reg_oesp);
+  cprintf("  ebx  0x%08x\n", regs->reg_ebx);
+  cprintf("  edx  0x%08x\n", regs->reg_edx);
+  cprintf("  ecx  0x%08x\n", regs->reg_ecx);
+  cprintf("  eax  0x%08x\n", regs->reg_eax);
+}
+
+void print_trap_stats(void) {
+  cprintf("%-4s %-28s %10s %10s %10s %10s\n",
+      "vec", "name", "count", "min", "avg", "max");
+  for (int i = 0; i < NVECTORS; i++) {
+    struct TrapStat *st = &trap_stats[i];
+    if (st->count == 0) continue;
+    uint64_t avg = st->ntimed ? st->cycles / st->ntimed : 0;
+    cprintf("%-4d %-28s %10llu %10u %10llu %10u\n", i, trapname(i),
+        st->count, st->min_cycles, avg, st->max_cycles);
+  }
+}
+
+static void trap_dispatch(struct Trapframe *tf) {
+  trap_handler_t handler = trap_handlers[tf->tf_trapno];
+  if (handler) {
+    handler(tf);
+    return;
+  }
+  
+  // Unexpected trap: the user process or the kernel has a bug
+  print_trapframe(tf);
+  if ((tf->tf_cs & 3) == 0) {
+    panic("unhandled trap %d (%s)", tf->tf_trapno, trapname(tf->tf_trapno));
+  }
+  env_destroy(curenv);
+}
+
+// Called from _alltraps in kern/trapentry.S
+void trap(struct Trapframe *tf) {
+  uint64_t start = read_tsc();
+  
+  // The interrupted code may have set DF
+  // and some versions of GCC rely on DF being clear
+  asm volatile("cld" ::: "cc");
+  
+  // Interrupts are disabled by the interrupt gate
+  // and must stay disabled while the kernel handles a trap
+  assert(!(read_eflags() & FL_IF));
+  
+  struct TrapStat *st = &trap_stats[tf->tf_trapno];
+  st->count++;
+  
+  // A trap from user mode interrupted curenv
+  // Copy its registers to curenv->env_tf, so that the environment can be
+  // resumed from there; the trapframe on the stack is ignored from now on
+  bool from_user = (tf->tf_cs & 3) == 3;
+  if (from_user) {
+    assert(curenv);
+    curenv->env_tf = *tf;
+    tf = &curenv->env_tf;
+  }
+  
+  trap_dispatch(tf);
+  
+  uint32_t cycles = read_tsc() - start;
+  if (st->ntimed++ == 0 || cycles < st->min_cycles) st->min_cycles = cycles;
+  if (cycles > st->max_cycles) st->max_cycles = cycles;
+  st->cycles += cycles;
+  
+  // Return to the interrupted environment
+  // It is still running, or the handler would not have returned
+  if (from_user) env_run(curenv);
+}
+
+/**** Benchmarks ****/
+
+static trap_handler_t bench_saved_handler;
+
+static void bench_trap_nop(struct Trapframe *tf) {}
+
+static void bench_trap_setup(void) {
+  bench_saved_handler = trap_register(T_SYSCALL, bench_trap_nop);
+}
+
+// A full round trip through the IDT gate, _alltraps, trap() and iret
+static void bench_trap(void) {
+  asm volatile("int %0" : : "i" (T_SYSCALL) : "cc", "memory");
+}
+
+static void bench_trap_teardown(void) {
+  trap_register(T_SYSCALL, bench_saved_handler);
+}
+BENCH(trap_int, "trap/int+iret",
+    bench_trap_setup, bench_trap, bench_trap_teardown, 0);
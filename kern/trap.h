@@ -0,0 +1,37 @@
+#ifndef KERN_TRAP_H
+#define KERN_TRAP_H
+
+#include <inc/trap.h>
+#include <inc/mmu.h>
+
+#define NVECTORS 256
+
+typedef void (*trap_handler_t)(struct Trapframe *tf);
+
+// Per-vector statistics
+// Handling cycles are counted from the entry to trap() until the handler
+// returns, so traps whose handlers never return are only counted
+struct TrapStat {
+  uint64_t count; // Number of traps
+  uint64_t ntimed; // Number of traps whose handler returned
+  uint64_t cycles; // Total handling cycles of those traps
+  uint32_t min_cycles;
+  uint32_t max_cycles;
+};
+
+extern struct Gatedesc idt[];
+extern struct Pseudodesc idt_pd;
+extern struct TrapStat trap_stats[];
+
+void trap_init(void);
+void trap_init_percpu(void);
+void trap_set_kstack(uintptr_t esp);
+// Call `handler` for traps with number `trapno`
+// The previous handler is returned
+trap_handler_t trap_register(int trapno, trap_handler_t handler);
+const char *trapname(int trapno);
+void print_trapframe(struct Trapframe *tf);
+void print_regs(struct PushRegs *regs);
+void print_trap_stats(void);
+
+#endif // KERN_TRAP_H
@@ -0,0 +1,529 @@
+#include <kern/vma.h>
+#include <inc/mmu.h>
+#include <inc/error.h>
+#include <inc/string.h>
+#include <inc/assert.h>
+#include <kern/env.h>
+#include <kern/pmap.h>
+#include <kern/bench.h>
+
+// The areas of an environment are the nodes of an AVL tree ordered by
+// address, rooted at env_vmas. Since areas do not overlap, their ends
+// are in the same order as their starts, so the tree answers which area
+// contains an address, or comes first after it, in O(log n).
+// Adjacent areas of the same kind are merged.
+
+/**** Allocation of areas ****/
+
+// Areas are carved out of pages that are kept for reuse
+static struct Vma *vma_free_list; // Linked through vma_left
+
+static struct Vma* vma_alloc(void) {
+  if (!vma_free_list) {
+    struct PageInfo *pp = page_alloc(0);
+    if (!pp) return NULL;
+    pp->pp_ref++;
+    struct Vma *v = page2kva(pp);
+    for (int i = 0; i < PGSIZE / sizeof(*v); i++) {
+      v[i].vma_left = vma_free_list;
+      vma_free_list = &v[i];
+    }
+  }
+  struct Vma *v = vma_free_list;
+  vma_free_list = v->vma_left;
+  return v;
+}
+
+static void vma_dealloc(struct Vma *v) {
+  v->vma_left = vma_free_list;
+  vma_free_list = v;
+}
+
+/**** AVL tree ****/
+
+static int vma_height(const struct Vma *v) {
+  return v ? v->vma_height : 0;
+}
+
+static void vma_update(struct Vma *v) {
+  v->vma_height = 1 + MAX(vma_height(v->vma_left), vma_height(v->vma_right));
+}
+
+static struct Vma* vma_rotate_right(struct Vma *v) {
+  struct Vma *l = v->vma_left;
+  v->vma_left = l->vma_right;
+  l->vma_right = v;
+  vma_update(v);
+  vma_update(l);
+  return l;
+}
+
+static struct Vma* vma_rotate_left(struct Vma *v) {
+  struct Vma *r = v->vma_right;
+  v->vma_right = r->vma_left;
+  r->vma_left = v;
+  vma_update(v);
+  vma_update(r);
+  return r;
+}
+
+// Restore the balance of `v`, whose subtrees differ in height by at
+// most 2, and return the new root of the subtree
+static struct Vma* vma_rebalance(struct Vma *v) {
+  vma_update(v);
+  int balance = vma_height(v->vma_left) - vma_height(v->vma_right);
+  if (balance > 1) {
+    struct Vma *l = v->vma_left;
+    if (vma_height(l->vma_left) < vma_height(l->vma_right)) {
+      v->vma_left = vma_rotate_left(l);
+    }
+    return vma_rotate_right(v);
+  }
+  if (balance < -1) {
+    struct Vma *r = v->vma_right;
+    if (vma_height(r->vma_right) < vma_height(r->vma_left)) {
+      v->vma_right = vma_rotate_right(r);
+    }
+    return vma_rotate_left(v);
+  }
+  return v;
+}
+
+static struct Vma* vma_tree_insert(struct Vma *root, struct Vma *v) {
+  if (!root) return v;
+  if (v->vma_start < root->vma_start) {
+    root->vma_left = vma_tree_insert(root->vma_left, v);
+  } else {
+    root->vma_right = vma_tree_insert(root->vma_right, v);
+  }
+  return vma_rebalance(root);
+}
+
+// Unlink the leftmost node of `root` into *min
+static struct Vma* vma_tree_remove_min(struct Vma *root, struct Vma **min) {
+  if (!root->vma_left) {
+    *min = root;
+    return root->vma_right;
+  }
+  root->vma_left = vma_tree_remove_min(root->vma_left, min);
+  return vma_rebalance(root);
+}
+
+// Remove and free the area starting at `start`
+static struct Vma* vma_tree_remove(struct Vma *root, uintptr_t start) {
+  if (!root) return NULL;
+  if (start < root->vma_start) {
+    root->vma_left = vma_tree_remove(root->vma_left, start);
+  } else if (start > root->vma_start) {
+    root->vma_right = vma_tree_remove(root->vma_right, start);
+  } else {
+    struct Vma *l = root->vma_left, *r = root->vma_right;
+    vma_dealloc(root);
+    if (!r) return l;
+    struct Vma *min;
+    r = vma_tree_remove_min(r, &min);
+    min->vma_left = l;
+    min->vma_right = r;
+    return vma_rebalance(min);
+  }
+  return vma_rebalance(root);
+}
+
+// Return the first area that ends after `va`, or NULL
+static struct Vma* vma_first_after(struct Vma *v, uintptr_t va) {
+  struct Vma *found = NULL;
+  while (v) {
+    if (v->vma_end > va) {
+      found = v;
+      v = v->vma_left;
+    } else {
+      v = v->vma_right;
+    }
+  }
+  return found;
+}
+
+// Return the last area that starts before `va`, or NULL
+static struct Vma* vma_last_before(struct Vma *v, uintptr_t va) {
+  struct Vma *found = NULL;
+  while (v) {
+    if (v->vma_start < va) {
+      found = v;
+      v = v->vma_right;
+    } else {
+      v = v->vma_left;
+    }
+  }
+  return found;
+}
+
+static void vma_tree_free(struct Vma *v) {
+  if (!v) return;
+  vma_tree_free(v->vma_left);
+  vma_tree_free(v->vma_right);
+  vma_dealloc(v);
+}
+
+// Copy the tree `src` to *dst
+// On failure, *dst is a partial copy to be freed by the caller.
+static int vma_tree_copy(struct Vma **dst, const struct Vma *src) {
+  *dst = NULL;
+  if (!src) return 0;
+  struct Vma *v = vma_alloc();
+  if (!v) return -E_NO_MEM;
+  *v = *src;
+  *dst = v;
+  int r = vma_tree_copy(&v->vma_left, src->vma_left);
+  if (r < 0) {
+    v->vma_right = NULL;
+    return r;
+  }
+  return vma_tree_copy(&v->vma_right, src->vma_right);
+}
+
+/**** Areas ****/
+
+// Return the area of `e` containing `va`, or NULL
+struct Vma* vma_lookup(struct Env *e, uintptr_t va) {
+  struct Vma *v = e->env_vmas;
+  while (v) {
+    if (va < v->vma_start) {
+      v = v->vma_left;
+    } else if (va >= v->vma_end) {
+      v = v->vma_right;
+    } else {
+      return v;
+    }
+  }
+  return NULL;
+}
+
+// Return true if a page may be mapped at `va` of `e` with `perm`
+// Within an area, pages may not be writable unless the area is.
+bool vma_allows(struct Env *e, uintptr_t va, int perm) {
+  struct Vma *v = vma_lookup(e, va);
+  return !v || !(perm & PTE_W) || (v->vma_perm & PTE_W);
+}
+
+// Return true if area `b` continues area `a`, so they can be one area
+static bool vma_continues(const struct Vma *a, const struct Vma *b) {
+  return a->vma_end == b->vma_start && a->vma_type == b->vma_type &&
+    a->vma_perm == b->vma_perm && (a->vma_type != VMA_FILE ||
+      a->vma_file + (a->vma_end - a->vma_start) == b->vma_file);
+}
+
+// Move the start of `v` to `start`, which keeps the order of the tree as
+// long as no other area is in between
+// The start moves down when `v` is merged with the area before it.
+static void vma_set_start(struct Vma *v, uintptr_t start) {
+  if (v->vma_type == VMA_FILE) {
+    v->vma_file += (intptr_t)(start - v->vma_start);
+  }
+  v->vma_start = start;
+}
+
+static int vma_add(struct Env *e, uintptr_t start, uintptr_t end, int type,
+    int perm, const uint8_t *file) {
+  struct Vma *next = vma_first_after(e->env_vmas, start);
+  if (next && next->vma_start < end) return -E_INVAL;
+  struct Vma *prev = vma_last_before(e->env_vmas, start);
+  
+  // Growing an area keeps the order of the tree, as there is no other
+  // area in between
+  struct Vma area = {
+    .vma_start = start, .vma_end = end, .vma_type = type, .vma_perm = perm,
+    .vma_file = file,
+  };
+  bool merge_prev = prev && vma_continues(prev, &area);
+  bool merge_next = next && vma_continues(&area, next);
+  if (merge_prev && merge_next) {
+    prev->vma_end = next->vma_end;
+    e->env_vmas = vma_tree_remove(e->env_vmas, next->vma_start);
+    e->env_nvma--;
+  } else if (merge_prev) {
+    prev->vma_end = end;
+  } else if (merge_next) {
+    vma_set_start(next, start);
+  } else {
+    struct Vma *v = vma_alloc();
+    if (!v) return -E_NO_MEM;
+    *v = area;
+    v->vma_height = 1;
+    e->env_vmas = vma_tree_insert(e->env_vmas, v);
+    e->env_nvma++;
+  }
+  return 0;
+}
+
+// Add the area [start, end) of kind `type` to `e`
+// The pages of the area will be mapped with permissions `perm`.
+// Returns 0 on success, < 0 on error. Errors are:
+//   -E_INVAL if the range overlaps an area of `e`
+//   -E_NO_MEM on memory exhaustion
+int vma_insert(struct Env *e, uintptr_t start, uintptr_t end, int type,
+    int perm) {
+  return vma_add(e, start, end, type, perm, NULL);
+}
+
+// Add the VMA_FILE area [start, end) to `e`, whose contents are at
+// the page aligned kernel address `file`
+// The pages there are mapped into `e` as they are, so must stay
+// allocated while mapped, e.g. by holding a reference to them.
+// Returns like vma_insert.
+int vma_insert_file(struct Env *e, uintptr_t start, uintptr_t end, int perm,
+    const uint8_t *file) {
+  return vma_add(e, start, end, VMA_FILE, perm, file);
+}
+
+// Remove the range [start, end) from the areas of `e`
+// Areas partly in the range are trimmed.
+// Returns 0 on success, or -E_NO_MEM if an area would be split in two
+// and there is no memory for another area
+int vma_remove(struct Env *e, uintptr_t start, uintptr_t end) {
+  struct Vma *v = vma_first_after(e->env_vmas, start);
+  if (!v || v->vma_start >= end) return 0;
+  
+  if (v->vma_start < start && v->vma_end > end) {
+    struct Vma *w = vma_alloc();
+    if (!w) return -E_NO_MEM;
+    *w = *v;
+    vma_set_start(w, end);
+    w->vma_left = w->vma_right = NULL;
+    w->vma_height = 1;
+    v->vma_end = start;
+    e->env_vmas = vma_tree_insert(e->env_vmas, w);
+    e->env_nvma++;
+    return 0;
+  }
+  
+  if (v->vma_start < start) {
+    v->vma_end = start;
+    v = vma_first_after(e->env_vmas, start);
+  }
+  while (v && v->vma_end <= end) {
+    e->env_vmas = vma_tree_remove(e->env_vmas, v->vma_start);
+    e->env_nvma--;
+    v = vma_first_after(e->env_vmas, start);
+  }
+  if (v && v->vma_start < end) vma_set_start(v, end);
+  return 0;
+}
+
+// Give `dst`, which has no areas, the areas of `src`
+// Returns 0 on success, or -E_NO_MEM
+int vma_copy(struct Env *dst, struct Env *src) {
+  int r = vma_tree_copy(&dst->env_vmas, src->env_vmas);
+  if (r < 0) {
+    vma_free(dst);
+    return r;
+  }
+  dst->env_nvma = src->env_nvma;
+  return 0;
+}
+
+// Remove all areas of `e`
+void vma_free(struct Env *e) {
+  vma_tree_free(e->env_vmas);
+  e->env_vmas = NULL;
+  e->env_nvma = 0;
+}
+
+/**** Page faults ****/
+
+// Pages around a fault in a VMA_FILE area are mapped along with the
+// faulting one, since the next accesses are likely to be nearby, e.g.
+// when a program starts running. The window is aligned to its size, a
+// power of two, so that it is always within one page table.
+static int fault_around = FAULT_AROUND_PAGES;
+
+// Set the fault-around window to `npages`, a power of two up to
+// NPTENTRIES
+// 1 maps only the faulting page. Returns 0, or -E_INVAL.
+int vma_set_fault_around(int npages) {
+  if (npages < 1 || npages > NPTENTRIES || (npages & (npages - 1))) {
+    return -E_INVAL;
+  }
+  fault_around = npages;
+  return 0;
+}
+
+int vma_get_fault_around(void) {
+  return fault_around;
+}
+
+// Map the missing pages of the fault-around window at `va` in `v`
+// All of them are found with a single walk of the page directory.
+static int vma_fault_file(struct Env *e, struct Vma *v, uintptr_t va) {
+  uintptr_t size = fault_around * PGSIZE;
+  uintptr_t start = MAX(ROUNDDOWN(va, size), v->vma_start);
+  uintptr_t end = MIN(ROUNDDOWN(va, size) + size, v->vma_end);
+  pte_t *pte = pgdir_walk(e->env_pgdir, (void*)start, 1);
+  if (!pte) return -E_NO_MEM;
+  
+  for (uintptr_t a = start; a < end; a += PGSIZE, pte++) {
+    if (*pte & PTE_P) continue;
+    struct PageInfo *pp = pa2page(PADDR((void*)(v->vma_file + (a - v->vma_start))));
+    pp->pp_ref++;
+    // The page was not present, so there is no TLB entry to invalidate
+    *pte = page2pa(pp) | v->vma_perm | PTE_P;
+    if (a != ROUNDDOWN(va, PGSIZE)) e->env_pgfaults_around++;
+  }
+  return 0;
+}
+
+// Map the missing page at `va` in `e` as its area says
+// `err` is the error code of the page fault, where FEC_WR means a write.
+// Returns 0 on success, < 0 on error. Errors are:
+//   -E_FAULT if the page is present, or no area allows the access
+//   -E_NO_MEM on memory exhaustion
+int vma_fault(struct Env *e, uintptr_t va, uint32_t err) {
+  struct Vma *v = vma_lookup(e, va);
+  if (!v || (err & FEC_PR)) return -E_FAULT;
+  if ((err & FEC_WR) && !(v->vma_perm & PTE_W)) return -E_FAULT;
+  
+  if (v->vma_type == VMA_FILE) return vma_fault_file(e, v, va);
+  assert(v->vma_type == VMA_ZERO);
+  struct PageInfo *pp = page_alloc(ALLOC_ZERO);
+  if (!pp) return -E_NO_MEM;
+  if (page_insert(e->env_pgdir, pp, (void*)ROUNDDOWN(va, PGSIZE),
+        v->vma_perm | PTE_P) < 0) {
+    page_free(pp);
+    return -E_NO_MEM;
+  }
+  return 0;
+}
+
+/**** Benchmarks ****/
+
+// A sparse 64 MiB heap of which 16 pages are used, allocated up front
+// versus on demand
+#define BENCH_HEAP_VA 0x10000000
+#define BENCH_HEAP_SIZE (64 * 1024 * 1024)
+#define BENCH_HEAP_TOUCH 16
+
+static struct Env *bench_env;
+
+static void bench_heap_eager(void) {
+  if (env_alloc(&bench_env, 0) < 0) panic("env_alloc failed");
+  for (uintptr_t va = BENCH_HEAP_VA; va < BENCH_HEAP_VA + BENCH_HEAP_SIZE;
+      va += PGSIZE) {
+    struct PageInfo *pp = page_alloc(ALLOC_ZERO);
+    if (!pp || page_insert(bench_env->env_pgdir, pp, (void*)va,
+          PTE_U | PTE_W) < 0) {
+      panic("bench_heap_eager: out of memory");
+    }
+  }
+  env_free(bench_env);
+}
+BENCH(heap_eager, "vma/heap/64MiB/eager", NULL, bench_heap_eager, NULL, 10);
+
+static void bench_heap_lazy(void) {
+  if (env_alloc(&bench_env, 0) < 0) panic("env_alloc failed");
+  if (vma_insert(bench_env, BENCH_HEAP_VA, BENCH_HEAP_VA + BENCH_HEAP_SIZE,
+        VMA_ZERO, PTE_U | PTE_W) < 0) {
+    panic("vma_insert failed");
+  }
+  uintptr_t stride = BENCH_HEAP_SIZE / BENCH_HEAP_TOUCH;
+  for (int i = 0; i < BENCH_HEAP_TOUCH; i++) {
+    if (vma_fault(bench_env, BENCH_HEAP_VA + i * stride, FEC_WR | FEC_U) < 0) {
+      panic("vma_fault failed");
+    }
+  }
+  env_free(bench_env);
+}
+BENCH(heap_lazy, "vma/heap/64MiB/lazy", NULL, bench_heap_lazy, NULL, 0);
+
+// Lookups among many small areas, e.g. of an environment that has mapped
+// thousands of files or buffers
+#define BENCH_NVMA 4096
+
+static void bench_vma_setup(void) {
+  if (env_alloc(&bench_env, 0) < 0) panic("env_alloc failed");
+  // Areas are a page apart, so that they are not merged
+  for (int i = 0; i < BENCH_NVMA; i++) {
+    uintptr_t va = BENCH_HEAP_VA + 2 * i * PGSIZE;
+    if (vma_insert(bench_env, va, va + PGSIZE, VMA_ZERO, PTE_U | PTE_W) < 0) {
+      panic("vma_insert failed");
+    }
+  }
+}
+
+static void bench_vma_teardown(void) {
+  env_free(bench_env);
+}
+
+static uint32_t bench_vma_seed = 1;
+
+static uintptr_t bench_vma_random(void) {
+  bench_vma_seed = bench_vma_seed * 1103515245 + 12345;
+  return BENCH_HEAP_VA + 2 * (bench_vma_seed % BENCH_NVMA) * PGSIZE;
+}
+
+static void bench_vma_lookup(void) {
+  if (!vma_lookup(bench_env, bench_vma_random())) panic("vma_lookup failed");
+}
+BENCH(vma_lookup, "vma/lookup/4096", bench_vma_setup, bench_vma_lookup,
+    bench_vma_teardown, 0);
+
+// Insert an area into a gap, and remove it again
+static void bench_vma_insert_remove(void) {
+  uintptr_t va = bench_vma_random() + PGSIZE;
+  if (vma_insert(bench_env, va, va + PGSIZE, VMA_ZERO, PTE_U) < 0) {
+    panic("vma_insert failed");
+  }
+  vma_remove(bench_env, va, va + PGSIZE);
+}
+BENCH(vma_insert_remove, "vma/insert+remove/4096", bench_vma_setup,
+    bench_vma_insert_remove, bench_vma_teardown, 0);
+
+// Touching every page of a 64 page file area in order, e.g. the text of
+// a program as it starts, one fault per page versus per 16 pages
+#define BENCH_FILE_PAGES 64
+
+static uint8_t bench_file[BENCH_FILE_PAGES * PGSIZE]
+  __attribute__((__aligned__(PGSIZE)));
+static int bench_fault_around;
+
+static void bench_file_setup(int npages) {
+  if (env_alloc(&bench_env, 0) < 0) panic("env_alloc failed");
+  // Pin the pages, as mappings of them are removed
+  for (int i = 0; i < BENCH_FILE_PAGES; i++) {
+    pa2page(PADDR(bench_file + i * PGSIZE))->pp_ref++;
+  }
+  bench_fault_around = vma_get_fault_around();
+  vma_set_fault_around(npages);
+}
+
+static void bench_file_setup_1(void) {
+  bench_file_setup(1);
+}
+
+static void bench_file_setup_16(void) {
+  bench_file_setup(16);
+}
+
+static void bench_file_teardown(void) {
+  vma_set_fault_around(bench_fault_around);
+  env_free(bench_env);
+  for (int i = 0; i < BENCH_FILE_PAGES; i++) {
+    pa2page(PADDR(bench_file + i * PGSIZE))->pp_ref--;
+  }
+}
+
+static void bench_file_touch(void) {
+  uintptr_t end = BENCH_HEAP_VA + BENCH_FILE_PAGES * PGSIZE;
+  if (vma_insert_file(bench_env, BENCH_HEAP_VA, end, PTE_U, bench_file) < 0) {
+    panic("vma_insert_file failed");
+  }
+  for (uintptr_t va = BENCH_HEAP_VA; va < end; va += PGSIZE) {
+    pte_t *pte = pgdir_walk(bench_env->env_pgdir, (void*)va, 0);
+    if (pte && (*pte & PTE_P)) continue;
+    if (vma_fault(bench_env, va, FEC_U) < 0) panic("vma_fault failed");
+  }
+  page_remove_range(bench_env->env_pgdir, BENCH_HEAP_VA, end);
+  vma_remove(bench_env, BENCH_HEAP_VA, end);
+}
+BENCH(fault_around_1, "vma/faultaround/64pages/1", bench_file_setup_1,
+    bench_file_touch, bench_file_teardown, 0);
+BENCH(fault_around_16, "vma/faultaround/64pages/16", bench_file_setup_16,
+    bench_file_touch, bench_file_teardown, 0);
@@ -0,0 +1,43 @@
+#ifndef KERN_VMA_H
+#define KERN_VMA_H
+
+#include <inc/env.h>
+
+// Kinds of virtual memory areas
+enum {
+  VMA_ZERO = 1, // Pages are allocated zeroed on first touch
+  VMA_FILE, // Pages of resident contents, e.g. of an ELF image
+};
+
+// Default number of pages mapped by a fault in a VMA_FILE area
+#define FAULT_AROUND_PAGES 16
+
+// A range [vma_start, vma_end) of the address space of an environment,
+// whose missing pages are mapped by the page fault handler
+// The areas of an environment do not overlap, and form an AVL tree
+// ordered by address.
+struct Vma {
+  uintptr_t vma_start;
+  uintptr_t vma_end;
+  uint16_t vma_type;
+  uint16_t vma_perm; // Permissions of the pages
+  const uint8_t *vma_file; // VMA_FILE: kernel address of vma_start's page
+  struct Vma *vma_left;
+  struct Vma *vma_right;
+  int vma_height; // Height of the subtree, 1 for a leaf
+};
+
+struct Vma* vma_lookup(struct Env *e, uintptr_t va);
+bool vma_allows(struct Env *e, uintptr_t va, int perm);
+int vma_insert(struct Env *e, uintptr_t start, uintptr_t end, int type,
+    int perm);
+int vma_insert_file(struct Env *e, uintptr_t start, uintptr_t end, int perm,
+    const uint8_t *file);
+int vma_remove(struct Env *e, uintptr_t start, uintptr_t end);
+int vma_copy(struct Env *dst, struct Env *src);
+void vma_free(struct Env *e);
+int vma_fault(struct Env *e, uintptr_t va, uint32_t err);
+int vma_set_fault_around(int npages);
+int vma_get_fault_around(void);
+
+#endif // KERN_VMA_H
@@ -0,0 +1,27 @@
+#include <inc/lib.h>
+
+void cputchar(int ch) {
+  char c = ch;
+  
+  // Unlike standard Unix's putchar,
+  // the cputchar function _always_ outputs to the system console
+  sys_cputs(&c, 1);
+}
+
+int getchar(void) {
+  int r;
+  while ((r = sys_cgetc()) == 0);
+  return r;
+}
+
+int cons_read(char *buf, int n) {
+  if (n <= 0) return 0;
+  int r = getchar();
+  if (r < 0) return r;
+  buf[0] = r;
+  return 1;
+}
+
+int iscons(int fdnum) {
+  return 1;
+}
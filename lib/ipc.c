@@ -0,0 +1,47 @@
+// User-level IPC library routines
+#include <inc/lib.h>
+
+// Receive a value via IPC and return it
+// If 'pg' is nonnull, then any page sent by the sender will be mapped at
+// that address.
+// If 'from_env_store' is nonnull, then store the IPC sender's envid in
+// *from_env_store.
+// If 'perm_store' is nonnull, then store the IPC sender's page permission
+// in *perm_store (this is nonzero iff a page was successfully
+// transferred to 'pg').
+// If the system call fails, then store 0 in *fromenv and *perm (if
+// they're nonnull) and return the error.
+// Otherwise, return the value sent by the sender
+int32_t ipc_recv(envid_t *from_env_store, void *pg, int *perm_store) {
+  int r = sys_ipc_recv(pg ? pg : (void*)UTOP, 0);
+  if (from_env_store) *from_env_store = r < 0 ? 0 : thisenv->env_ipc_from;
+  if (perm_store) *perm_store = r < 0 ? 0 : thisenv->env_ipc_perm;
+  return r < 0 ? r : (int32_t)thisenv->env_ipc_value;
+}
+
+// Send 'val' (and 'pg' with 'perm', if 'pg' is nonnull) to 'toenv'
+// This function keeps trying until it succeeds, yielding the CPU while
+// 'to_env' is not receiving. It should panic() on any other error.
+void ipc_send(envid_t to_env, uint32_t val, void *pg, int perm) {
+  int r;
+  while ((r = sys_ipc_try_send(to_env, val, pg ? pg : (void*)UTOP, perm)) ==
+      -E_IPC_NOT_RECV) {
+    sys_yield();
+  }
+  if (r < 0) panic("sys_ipc_try_send: %e", r);
+}
+
+// Send like ipc_send and wait for the reply like ipc_recv, mapping any
+// page in the reply at 'rcv_pg' if it is nonnull
+// The sender and the page permission of the reply are in thisenv.
+// Returns the value of the reply.
+int32_t ipc_call(envid_t to_env, uint32_t val, void *pg, int perm,
+    void *rcv_pg) {
+  int r;
+  while ((r = sys_ipc_call(to_env, val, pg ? pg : (void*)UTOP, perm,
+          rcv_pg ? rcv_pg : (void*)UTOP, 0)) == -E_IPC_NOT_RECV) {
+    sys_yield();
+  }
+  if (r < 0) panic("sys_ipc_call: %e", r);
+  return thisenv->env_ipc_value;
+}
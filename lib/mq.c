@@ -0,0 +1,42 @@
+// Asynchronous message queues
+#include <inc/lib.h>
+
+// Allocate the page at `va` for the message queue of this environment
+// and set it up
+// Returns the queue, or NULL on error.
+struct MsgQueue* mq_init(void *va) {
+  if (sys_page_alloc(0, va, PTE_P | PTE_U | PTE_W) < 0) return NULL;
+  if (sys_mq_setup(va) < 0) {
+    sys_page_unmap(0, va);
+    return NULL;
+  }
+  return va;
+}
+
+// Take the oldest message off `q` into `msg`
+// Returns false if there is none.
+bool mq_tryrecv(struct MsgQueue *q, struct Msg *msg) {
+  uint32_t head = q->mq_head;
+  if (head == q->mq_tail) return false;
+  *msg = q->mq_msgs[head % MQ_NMSGS];
+  // The message must be read before the kernel may reuse its slot
+  asm volatile("" : : : "memory");
+  q->mq_head = head + 1;
+  return true;
+}
+
+// Take the oldest message off `q` into `msg`, blocking while there is none
+void mq_recv(struct MsgQueue *q, struct Msg *msg) {
+  int r;
+  while (!mq_tryrecv(q, msg)) {
+    if ((r = sys_mq_wait(0)) < 0) panic("sys_mq_wait: %e", r);
+  }
+}
+
+// Queue `value` for `to_env`, yielding the CPU while its queue is full
+// Panics on other errors.
+void mq_send(envid_t to_env, uint32_t value) {
+  int r;
+  while ((r = sys_mq_send(to_env, value)) == -E_QUEUE_FULL) sys_yield();
+  if (r < 0) panic("sys_mq_send: %e", r);
+}
@@ -0,0 +1,34 @@
+// Mutexes in user memory, which may be shared between environments
+#include <inc/lib.h>
+#include <inc/x86.h>
+
+// A mutex is a word that is 0 if it is unlocked, 1 if it is locked, and
+// 2 if it is locked and environments may be waiting for it. Only
+// unlocking a mutex in state 2 takes a system call, to wake a waiter,
+// and waiting environments sleep on the futex of the word.
+
+void mutex_lock(volatile uint32_t *m) {
+  uint32_t c = cmpxchg(m, 0, 1);
+  if (c == 0) return;
+  // Mark the mutex as contended before sleeping, so that the holder
+  // wakes us, and keep it marked since others may still be waiting
+  if (c != 2) c = xchg(m, 2);
+  while (c != 0) {
+    int r = sys_futex_wait(m, 2, 0);
+    if (r < 0 && r != -E_AGAIN) panic("sys_futex_wait: %e", r);
+    c = xchg(m, 2);
+  }
+}
+
+void mutex_unlock(volatile uint32_t *m) {
+  if (xchg(m, 0) == 2) sys_futex_wake(m, 1);
+}
+
+// A lock that waiters poll, giving up the CPU between attempts
+void spin_lock(volatile uint32_t *m) {
+  while (xchg(m, 1) != 0) sys_yield();
+}
+
+void spin_unlock(volatile uint32_t *m) {
+  xchg(m, 0);
+}
@@ -0,0 +1,24 @@
+// User-level page fault handler support
+#include <inc/lib.h>
+
+// Assembly language pgfault entrypoint defined in lib/pfentry.S
+extern void _pgfault_upcall(void);
+
+// Pointer to currently installed C-language pgfault handler
+void (*_pgfault_handler)(struct UTrapframe *utf);
+
+// Set the page fault handler function
+// The first time, the exception stack is allocated, and the kernel is
+// told to call the assembly language _pgfault_upcall routine on a
+// page fault, which calls `handler`.
+void set_pgfault_handler(void (*handler)(struct UTrapframe *utf)) {
+  if (_pgfault_handler == NULL) {
+    int r = sys_page_alloc(0, (void*)(UXSTACKTOP - PGSIZE),
+        PTE_P | PTE_U | PTE_W);
+    if (r < 0) panic("set_pgfault_handler: %e", r);
+    if ((r = sys_env_set_pgfault_upcall(0, _pgfault_upcall)) < 0) {
+      panic("set_pgfault_handler: %e", r);
+    }
+  }
+  _pgfault_handler = handler;
+}
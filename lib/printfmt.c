@@ -9,7 +9,11 @@ static const char* const error_string[MAXERROR] = {
   [E_INVAL] = "invalid parameter",
   [E_NO_MEM] = "out of memory",
   [E_NO_FREE_ENV] = "out of environments",
-  [E_FAULT] = "segmentation fault"
+  [E_FAULT] = "segmentation fault",
+  [E_IPC_NOT_RECV] = "env is not recving",
+  [E_QUEUE_FULL] = "message queue is full",
+  [E_AGAIN] = "try again",
+  [E_TIMEOUT] = "timed out",
 };
 
 static void printnum(void (*putch)(int, void*), void* putdat,
@@ -44,16 +48,23 @@ static long long getint(va_list *ap, int lflag) {
 
 void printfmt(void (*putch)(int, void*), void* putdat, const char* fmt, ...);
 
-void vprintfmt(void (*putch)(int, void*), void* putdat, const char* fmt, va_list ap) {
+void vprintfmt(void (*putch)(int, void*), void* putdat, const char* fmt, va_list args) {
   register const char* p;
   register int ch, err;
   unsigned long long num;
   int base, lflag, width, precision, altflag;
   char padc;
+  // getint and getuint take a pointer to a local va_list, since a
+  // va_list parameter is only a pointer where va_list is an array type
+  va_list ap;
+  va_copy(ap, args);
   
   while(1) {
     while((ch=*(unsigned char*)fmt++) != '%') {
-      if (ch == '\0') return;
+      if (ch == '\0') {
+        va_end(ap);
+        return;
+      }
       putch(ch, putdat);
     }
     
@@ -3,12 +3,27 @@
 #define BUFLEN 1024
 static char buf[BUFLEN];
 
+// Input read ahead of the current line
+// The console is drained in bulk rather than one character per call.
+static char inbuf[64];
+static int inpos, inlen;
+
+static int readchar(void) {
+  if (inpos == inlen) {
+    inpos = inlen = 0;
+    int r = cons_read(inbuf, sizeof(inbuf));
+    if (r <= 0) return r;
+    inlen = r;
+  }
+  return (unsigned char) inbuf[inpos++];
+}
+
 char *readline(const char *prompt) {
   if (prompt != NULL) cprintf("%s", prompt);
   int i = 0;
   int echoing = iscons(0);
   while(1) {
-    int c = getchar();
+    int c = readchar();
     if (c < 0) {
       cprintf("read error: %e\n", c);
       return NULL;
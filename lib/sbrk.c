@@ -0,0 +1,28 @@
+// Heap of user programs, allocated on demand
+#include <inc/lib.h>
+
+extern char end[];
+static uintptr_t brk; // End of the heap
+
+// Grow the heap, which starts at the end of the program, by `increment`
+// bytes, or shrink it if `increment` is negative
+// The heap is a demand-zero area, so its pages are only allocated when
+// touched. Returns the previous end of the heap, or (void*)-1 on error.
+void* sbrk(intptr_t increment) {
+  if (!brk) brk = (uintptr_t)end;
+  uintptr_t old = brk, new = brk + increment;
+  if (increment >= 0 ? new < old : (new > old || new < (uintptr_t)end)) {
+    return (void*)-1;
+  }
+  
+  uintptr_t oldpg = ROUNDUP(old, PGSIZE), newpg = ROUNDUP(new, PGSIZE);
+  int r = 0;
+  if (newpg > oldpg) {
+    r = sys_region_alloc(0, (void*)oldpg, newpg - oldpg, PTE_P | PTE_U | PTE_W);
+  } else if (newpg < oldpg) {
+    r = sys_region_free(0, (void*)newpg, oldpg - newpg);
+  }
+  if (r < 0) return (void*)-1;
+  brk = new;
+  return (void*)old;
+}
@@ -1,15 +1,47 @@
 #include <inc/string.h>
+#include <inc/mmu.h>
+
+// Strings are scanned a 32-bit word at a time where possible.
+// HASZERO(x) is non-zero iff some byte of `x` is zero, and
+// HASZERO(x ^ REPEAT(c)) is non-zero iff some byte of `x` equals `c`.
+// An aligned word never straddles a page boundary, so reading the whole
+// word that holds the terminator cannot fault even if the rest of it
+// lies beyond the end of the string.
+typedef uint32_t __attribute__((__may_alias__)) word_t;
+typedef uint32_t __attribute__((__may_alias__, __aligned__(1))) uword_t;
+
+#define WORDSIZE sizeof(word_t)
+#define ONES 0x01010101U
+#define HIGHS 0x80808080U
+#define REPEAT(c) ((uint8_t)(c) * ONES)
+#define HASZERO(x) (((x) - ONES) & ~(x) & HIGHS)
+#define ALIGNED(p) (((uintptr_t)(p) & (WORDSIZE - 1)) == 0)
+
+// An unaligned word can be read safely only if it stays within one page
+static inline bool word_in_page(const void *p) {
+  return PGOFF(p) <= PGSIZE - WORDSIZE;
+}
 
 int strlen(const char* s) {
-  int n;
-  for (n=0; *s != '\0'; s++) n++;
-  return n;
+  const char *p = s;
+  for (; !ALIGNED(p); p++) {
+    if (*p == '\0') return p - s;
+  }
+  const word_t *w = (const word_t*)p;
+  while (!HASZERO(*w)) w++;
+  for (p = (const char*)w; *p != '\0'; p++);
+  return p - s;
 }
 
 int strnlen(const char* s, size_t size) {
-  int n;
-  for (n=0; size > 0 && *s != '\0'; s++, size--) n++;
-  return n;
+  const char *p = s;
+  for (; size > 0 && !ALIGNED(p); p++, size--) {
+    if (*p == '\0') return p - s;
+  }
+  const word_t *w = (const word_t*)p;
+  for (; size >= WORDSIZE && !HASZERO(*w); w++) size -= WORDSIZE;
+  for (p = (const char*)w; size > 0 && *p != '\0'; p++, size--);
+  return p - s;
 }
 
 char* strcpy(char *dst, const char *src) {
@@ -47,31 +79,67 @@ size_t strlcpy(char *dst, const char *src, size_t size) {
 }
 
 int strcmp(const char *p, const char *q) {
-  while(*p & (*p == *q)) p++, q++;
+  for (; !ALIGNED(p); p++, q++) {
+    if (*p == '\0' || *p != *q) goto done;
+  }
+  // `p` is aligned now; `q` may not be, so its word is read unaligned
+  // unless that word would cross into the next page
+  while (1) {
+    if (word_in_page(q)) {
+      word_t x = *(const word_t*)p;
+      if (HASZERO(x) || x != *(const uword_t*)q) break;
+      p += WORDSIZE, q += WORDSIZE;
+    } else {
+      for (int i = 0; i < WORDSIZE; i++, p++, q++) {
+        if (*p == '\0' || *p != *q) goto done;
+      }
+    }
+  }
+  while (*p != '\0' && *p == *q) p++, q++;
+done:
   return (int)((unsigned char)*p - (unsigned char)*q);
 }
 
 int strncmp(const char *p, const char *q, size_t n) {
-  while(n > 0 && *p && (*p == *q)) n--, p++, q++;
-  if (n == 0) {
-    return 0;
-  } else {
-    return (int) ((unsigned char)*p - (unsigned char)*q);
+  for (; n > 0 && !ALIGNED(p); n--, p++, q++) {
+    if (*p == '\0' || *p != *q) goto done;
+  }
+  while (n >= WORDSIZE) {
+    if (word_in_page(q)) {
+      word_t x = *(const word_t*)p;
+      if (HASZERO(x) || x != *(const uword_t*)q) break;
+      n -= WORDSIZE, p += WORDSIZE, q += WORDSIZE;
+    } else {
+      for (int i = 0; i < WORDSIZE; i++, n--, p++, q++) {
+        if (*p == '\0' || *p != *q) goto done;
+      }
+    }
   }
+  while (n > 0 && *p != '\0' && *p == *q) n--, p++, q++;
+  if (n == 0) return 0;
+done:
+  return (int)((unsigned char)*p - (unsigned char)*q);
 }
 
-char *strchr(const char *s, char c) {
-  for (; *s; s++) {
-    if (*s == c) return (char*)s;
+// Return a pointer to the first `c` or the terminating '\0' of `s`
+static const char *strscan(const char *s, char c) {
+  for (; !ALIGNED(s); s++) {
+    if (*s == '\0' || *s == c) return s;
   }
-  return 0;
+  const word_t *w = (const word_t*)s;
+  word_t cmask = REPEAT(c);
+  while (!HASZERO(*w) && !HASZERO(*w ^ cmask)) w++;
+  for (s = (const char*)w; *s != '\0' && *s != c; s++);
+  return s;
+}
+
+char *strchr(const char *s, char c) {
+  s = strscan(s, c);
+  return *s ? (char*)s : 0;
 }
 
 char *strfind(const char *s, char c) {
-  for (; *s; s++) {
-    if (*s == c) break;
-  }
-  return (char*)s;
+  return (char*)strscan(s, c);
 }
 
 void *memset(void *v, int c, size_t n) {
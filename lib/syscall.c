@@ -0,0 +1,165 @@
+// System call stubs
+#include <inc/syscall.h>
+#include <inc/lib.h>
+
+static inline int32_t syscall(int num, int check,
+    uint32_t a1, uint32_t a2, uint32_t a3, uint32_t a4, uint32_t a5) {
+  int32_t ret;
+  
+  // Generic system call: pass system call number in AX,
+  // up to five parameters in DX, CX, BX, DI, SI
+  // Call the stub the kernel maps at USYSCALL, which enters the kernel
+  // with sysenter, or with T_SYSCALL if the CPU lacks it
+  //
+  // The "volatile" tells the assembler not to optimize
+  // this instruction away just because we don't use the
+  // return value
+  //
+  // The last clause tells the assembler that this can
+  // potentially change the condition codes and arbitrary
+  // memory locations
+  asm volatile("call %c1\n"
+    : "=a" (ret)
+    : "i" (USYSCALL),
+      "a" (num),
+      "d" (a1),
+      "c" (a2),
+      "b" (a3),
+      "D" (a4),
+      "S" (a5)
+    : "cc", "memory");
+  
+  if(check && ret > 0) panic("syscall %d returned %d (> 0)", num, ret);
+  
+  return ret;
+}
+
+void sys_cputs(const char *s, size_t len) {
+  syscall(SYS_cputs, 0, (uint32_t)s, len, 0, 0, 0);
+}
+
+int sys_cgetc(void) {
+  return syscall(SYS_cgetc, 0, 0, 0, 0, 0, 0);
+}
+
+int sys_env_destroy(envid_t envid) {
+  return syscall(SYS_env_destroy, 1, envid, 0, 0, 0, 0);
+}
+
+// Returns 0 in each clone of the template, never in the template itself
+int sys_env_set_template(void) {
+  int r = syscall(SYS_env_set_template, 1, 0, 0, 0, 0, 0);
+  // thisenv still points to the template
+  if (r == 0) thisenv = &envs[ENVX(sys_getenvid())];
+  return r;
+}
+
+// Returns the child's envid to the parent and 0 to the child
+envid_t sys_fork(void) {
+  envid_t r = syscall(SYS_fork, 0, 0, 0, 0, 0, 0);
+  if (r == 0) thisenv = &envs[ENVX(sys_getenvid())];
+  return r;
+}
+
+void sys_yield(void) {
+  syscall(SYS_yield, 0, 0, 0, 0, 0, 0);
+}
+
+int sys_env_sleep(uint64_t ns) {
+  return syscall(SYS_env_sleep, 1, ns, ns >> 32, 0, 0, 0);
+}
+
+int sys_env_set_pgfault_upcall(envid_t envid, void *upcall) {
+  return syscall(SYS_env_set_pgfault_upcall, 1, envid, (uint32_t)upcall,
+      0, 0, 0);
+}
+
+int sys_page_alloc(envid_t envid, void *va, int perm) {
+  return syscall(SYS_page_alloc, 1, envid, (uint32_t)va, perm, 0, 0);
+}
+
+int sys_page_map(envid_t srcenv, void *srcva,
+    envid_t dstenv, void *dstva, int perm) {
+  return syscall(SYS_page_map, 1, srcenv, (uint32_t)srcva,
+      dstenv, (uint32_t)dstva, perm);
+}
+
+int sys_page_unmap(envid_t envid, void *va) {
+  return syscall(SYS_page_unmap, 1, envid, (uint32_t)va, 0, 0, 0);
+}
+
+int sys_region_alloc(envid_t envid, void *va, size_t len, int perm) {
+  return syscall(SYS_region_alloc, 1, envid, (uint32_t)va, len, perm, 0);
+}
+
+int sys_region_free(envid_t envid, void *va, size_t len) {
+  return syscall(SYS_region_free, 1, envid, (uint32_t)va, len, 0, 0);
+}
+
+int sys_ring_setup(void *va) {
+  return syscall(SYS_ring_setup, 1, (uint32_t)va, 0, 0, 0, 0);
+}
+
+int sys_ipc_try_send(envid_t envid, uint32_t value, void *srcva, int perm) {
+  return syscall(SYS_ipc_try_send, 0, envid, value, (uint32_t)srcva, perm, 0);
+}
+
+// A timeout of 0 waits without a time limit
+int sys_ipc_recv(void *dstva, uint32_t timeout_us) {
+  return syscall(SYS_ipc_recv, 1, (uint32_t)dstva, timeout_us, 0, 0, 0);
+}
+
+// The permission travels in the page offset of srcva, which leaves a
+// register for the timeout
+int sys_ipc_call(envid_t envid, uint32_t value, void *srcva, int perm,
+    void *dstva, uint32_t timeout_us) {
+  if (PGOFF(srcva) || (perm & ~0xFFF)) return -E_INVAL;
+  return syscall(SYS_ipc_call, 1, envid, value, (uint32_t)srcva | perm,
+      (uint32_t)dstva, timeout_us);
+}
+
+int sys_mq_setup(void *va) {
+  return syscall(SYS_mq_setup, 1, (uint32_t)va, 0, 0, 0, 0);
+}
+
+int sys_mq_send(envid_t envid, uint32_t value) {
+  return syscall(SYS_mq_send, 0, envid, value, 0, 0, 0);
+}
+
+int sys_mq_wait(uint32_t timeout_us) {
+  return syscall(SYS_mq_wait, 1, timeout_us, 0, 0, 0, 0);
+}
+
+// Returns the id of the shared memory object `name`
+int sys_shm_open(const char *name, size_t len) {
+  return syscall(SYS_shm_open, 0, (uint32_t)name, strlen(name), len, 0, 0);
+}
+
+int sys_shm_map(int shmid, void *va, int perm) {
+  return syscall(SYS_shm_map, 1, shmid, (uint32_t)va, perm, 0, 0);
+}
+
+int sys_shm_close(int shmid) {
+  return syscall(SYS_shm_close, 1, shmid, 0, 0, 0, 0);
+}
+
+// Returns 0 once woken, or -E_AGAIN if *addr != expected
+int sys_futex_wait(volatile uint32_t *addr, uint32_t expected,
+    uint32_t timeout_us) {
+  return syscall(SYS_futex_wait, 0, (uint32_t)addr, expected, timeout_us,
+      0, 0);
+}
+
+// Returns the number of environments woken
+int sys_futex_wake(volatile uint32_t *addr, int n) {
+  return syscall(SYS_futex_wake, 0, (uint32_t)addr, n, 0, 0, 0);
+}
+
+// Returns the number of system calls run from the ring
+int sys_ring_enter(void) {
+  return syscall(SYS_ring_enter, 0, 0, 0, 0, 0, 0);
+}
+
+envid_t sys_getenvid(void) {
+  return syscall(SYS_getenvid, 0, 0, 0, 0, 0, 0);
+}
@@ -0,0 +1,46 @@
+// Batched system calls through rings shared with the kernel
+#include <inc/lib.h>
+
+// Allocate the page at `va` for system call rings and set them up
+// Returns the rings, or NULL on error.
+struct SysRing* sysring_init(void *va) {
+  if (sys_page_alloc(0, va, PTE_P | PTE_U | PTE_W) < 0) return NULL;
+  if (sys_ring_setup(va) < 0) {
+    sys_page_unmap(0, va);
+    return NULL;
+  }
+  return va;
+}
+
+// Queue system call `num` with its arguments on `ring`, to be run by
+// sys_ring_enter
+// Its completion carries `data`. Returns false if the ring is full.
+bool sysring_queue(struct SysRing *ring, uint32_t data, uint32_t num,
+    uint32_t a1, uint32_t a2, uint32_t a3, uint32_t a4, uint32_t a5) {
+  uint32_t tail = ring->sq_tail;
+  if (tail - ring->sq_head == SYSRING_NSQE) return false;
+  struct SysSqe *sqe = &ring->sq[tail % SYSRING_NSQE];
+  sqe->sqe_num = num;
+  sqe->sqe_args[0] = a1;
+  sqe->sqe_args[1] = a2;
+  sqe->sqe_args[2] = a3;
+  sqe->sqe_args[3] = a4;
+  sqe->sqe_args[4] = a5;
+  sqe->sqe_data = data;
+  // The entry must be written before the kernel may run it
+  asm volatile("" : : : "memory");
+  ring->sq_tail = tail + 1;
+  return true;
+}
+
+// Take the oldest completion off `ring` into `cqe`
+// Returns false if there is none.
+bool sysring_complete(struct SysRing *ring, struct SysCqe *cqe) {
+  uint32_t head = ring->cq_head;
+  if (head == ring->cq_tail) return false;
+  *cqe = ring->cq[head % SYSRING_NCQE];
+  // The entry must be read before the kernel may reuse it
+  asm volatile("" : : : "memory");
+  ring->cq_head = head + 1;
+  return true;
+}
@@ -0,0 +1,18 @@
+// Allocate pages on demand from a user-level page fault handler
+#include <inc/lib.h>
+
+static void handler(struct UTrapframe *utf) {
+  void *addr = (void*)utf->utf_fault_va;
+  cprintf("fault %08x\n", addr);
+  int r = sys_page_alloc(0, ROUNDDOWN(addr, PGSIZE), PTE_P | PTE_U | PTE_W);
+  if (r < 0) panic("allocating at %08x in page fault handler: %e", addr, r);
+  // Near the end of a page, the handler itself faults on the next page,
+  // which is handled by a nested upcall
+  strcpy((char*)addr, "this string was faulted in");
+}
+
+void umain(int argc, char **argv) {
+  set_pgfault_handler(handler);
+  cprintf("%s\n", (char*)0xDeadBeef);
+  cprintf("%s\n", (char*)0xCafeBffe);
+}
@@ -0,0 +1,12 @@
+// Fork, and take turns printing from the parent and the child
+#include <inc/lib.h>
+
+void umain(int argc, char **argv) {
+  envid_t who = sys_fork();
+  if (who < 0) panic("sys_fork: %e", who);
+  for (int i = 0; i < 3; i++) {
+    cprintf("%d: I am the %s %08x\n", i, who ? "parent" : "child",
+        thisenv->env_id);
+    sys_yield();
+  }
+}
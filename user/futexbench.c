@@ -0,0 +1,75 @@
+// Cost of a contended lock: workers that poll a lock, yielding between
+// attempts, versus ones that sleep on its futex until it is released
+// There is no preemption, so each holder yields inside the critical
+// section to let the other workers contend for the lock.
+#include <inc/lib.h>
+#include <inc/x86.h>
+
+#define NWORKERS 4
+#define NITERS 1000
+#define SHMVA ((void*)0x10000000)
+
+struct Shared {
+  volatile uint32_t lock;
+  volatile uint32_t count;
+};
+
+static struct Shared *shared = SHMVA;
+
+static void work(bool futex) {
+  for (int i = 0; i < NITERS; i++) {
+    if (futex) mutex_lock(&shared->lock);
+    else spin_lock(&shared->lock);
+    uint32_t count = shared->count;
+    sys_yield();
+    shared->count = count + 1;
+    if (futex) mutex_unlock(&shared->lock);
+    else spin_unlock(&shared->lock);
+  }
+}
+
+static void run(const char *name, bool futex, envid_t parent) {
+  shared->lock = 0;
+  shared->count = 0;
+  uint64_t start = read_tsc();
+  for (int i = 0; i < NWORKERS; i++) {
+    envid_t worker = sys_fork();
+    if (worker < 0) panic("sys_fork: %e", worker);
+    if (worker == 0) {
+      work(futex);
+      ipc_send(parent, 0, NULL, 0);
+      exit();
+    }
+  }
+  for (int i = 0; i < NWORKERS; i++) ipc_recv(NULL, NULL, NULL);
+  uint64_t cycles = read_tsc() - start;
+  
+  if (shared->count != NWORKERS * NITERS) {
+    panic("%s: count %d, expected %d", name, shared->count,
+        NWORKERS * NITERS);
+  }
+  cprintf("%-5s %d workers, %llu cycles per acquisition\n",
+      name, NWORKERS, cycles / (NWORKERS * NITERS));
+}
+
+void umain(int argc, char **argv) {
+  int shmid = sys_shm_open("futexbench", PGSIZE);
+  if (shmid < 0) panic("sys_shm_open: %e", shmid);
+  int r = sys_shm_map(shmid, SHMVA, PTE_P | PTE_U | PTE_W);
+  if (r < 0) panic("sys_shm_map: %e", r);
+  
+  // A futex whose word changed is not waited on, and a wait that
+  // nobody ends times out
+  shared->lock = 1;
+  if ((r = sys_futex_wait(&shared->lock, 0, 0)) != -E_AGAIN) {
+    panic("sys_futex_wait on a changed word: %e", r);
+  }
+  if ((r = sys_futex_wait(&shared->lock, 1, 10000)) != -E_TIMEOUT) {
+    panic("sys_futex_wait without waker: %e", r);
+  }
+  
+  envid_t parent = sys_getenvid();
+  run("spin", false, parent);
+  run("futex", true, parent);
+  sys_shm_close(shmid);
+}
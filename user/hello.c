@@ -0,0 +1,7 @@
+// Hello, world
+#include <inc/lib.h>
+
+void umain(int argc, char **argv) {
+  cprintf("hello, world\n");
+  cprintf("i am environment %08x\n", thisenv->env_id);
+}
@@ -0,0 +1,47 @@
+// Round trip latency of synchronous IPC to a server that echoes each
+// message, with a 4-byte value and with a 4 KiB page
+#include <inc/lib.h>
+#include <inc/x86.h>
+
+#define NROUNDS 1000
+#define PAGEVA ((void*)0x10000000)
+
+static void serve(void) {
+  envid_t from;
+  int perm;
+  int32_t value = ipc_recv(&from, PAGEVA, &perm);
+  for (;;) {
+    value = ipc_call(from, value, perm ? PAGEVA : NULL, perm, PAGEVA);
+    from = thisenv->env_ipc_from;
+    perm = thisenv->env_ipc_perm;
+  }
+}
+
+static void bench(const char *name, envid_t server, void *pg, int perm) {
+  uint64_t min = ~0ULL, total = 0;
+  for (int i = 0; i < NROUNDS; i++) {
+    uint64_t start = read_tsc();
+    int32_t value = ipc_call(server, i, pg, perm, pg);
+    uint64_t cycles = read_tsc() - start;
+    if (value != i) panic("server replied %d to %d", value, i);
+    if (pg && thisenv->env_ipc_perm != perm) panic("page not returned");
+    if (cycles < min) min = cycles;
+    total += cycles;
+  }
+  cprintf("ipc round trip %-6s %6llu cycles min, %6llu avg\n",
+      name, min, total / NROUNDS);
+}
+
+void umain(int argc, char **argv) {
+  envid_t server = sys_fork();
+  if (server < 0) panic("sys_fork: %e", server);
+  if (server == 0) serve();
+  
+  int r;
+  if ((r = sys_page_alloc(0, PAGEVA, PTE_P | PTE_U | PTE_W)) < 0) {
+    panic("sys_page_alloc: %e", r);
+  }
+  bench("4B", server, NULL, 0);
+  bench("4KiB", server, PAGEVA, PTE_P | PTE_U | PTE_W);
+  sys_env_destroy(server);
+}
@@ -0,0 +1,17 @@
+// Grow the heap by 64 MiB and touch only a few pages of it
+#include <inc/lib.h>
+
+#define HEAPSIZE (64 * 1024 * 1024)
+#define NTOUCH 16
+
+void umain(int argc, char **argv) {
+  char *heap = sbrk(HEAPSIZE);
+  if (heap == (char*)-1) panic("sbrk failed");
+  for (int i = 0; i < NTOUCH; i++) heap[i * (HEAPSIZE / NTOUCH)] = i;
+  for (int i = 0; i < NTOUCH; i++) {
+    if (heap[i * (HEAPSIZE / NTOUCH)] != i) panic("heap corrupted");
+  }
+  cprintf("touched %d pages of a %d MiB heap at %08x\n",
+      NTOUCH, HEAPSIZE >> 20, heap);
+  if (sbrk(-HEAPSIZE) == (void*)-1) panic("sbrk failed");
+}
@@ -0,0 +1,54 @@
+// Throughput of messages from one environment to another, sent
+// synchronously, one context switch each, and through the receiver's
+// asynchronous message queue
+#include <inc/lib.h>
+#include <inc/x86.h>
+
+#define NMSGS 10000
+#define MQVA ((void*)0x10000000)
+
+// Receive NMSGS messages of each kind, and acknowledge each batch
+static void consume(envid_t producer) {
+  struct MsgQueue *q = mq_init(MQVA);
+  if (!q) panic("mq_init failed");
+  ipc_send(producer, 0, NULL, 0);
+  
+  for (int i = 0; i < NMSGS; i++) {
+    if (ipc_recv(NULL, NULL, NULL) != i) panic("message %d lost", i);
+  }
+  ipc_send(producer, 0, NULL, 0);
+  
+  struct Msg msg;
+  for (int i = 0; i < NMSGS; i++) {
+    mq_recv(q, &msg);
+    if (msg.msg_value != i) panic("message %d lost", i);
+  }
+  ipc_send(producer, 0, NULL, 0);
+}
+
+static void report(const char *name, uint64_t cycles) {
+  cprintf("%-5s %d messages, %llu cycles per message\n",
+      name, NMSGS, cycles / NMSGS);
+}
+
+void umain(int argc, char **argv) {
+  envid_t producer = sys_getenvid();
+  envid_t consumer = sys_fork();
+  if (consumer < 0) panic("sys_fork: %e", consumer);
+  if (consumer == 0) {
+    consume(producer);
+    return;
+  }
+  // The consumer has set up its queue
+  ipc_recv(NULL, NULL, NULL);
+  
+  uint64_t start = read_tsc();
+  for (int i = 0; i < NMSGS; i++) ipc_send(consumer, i, NULL, 0);
+  ipc_recv(NULL, NULL, NULL);
+  report("sync", read_tsc() - start);
+  
+  start = read_tsc();
+  for (int i = 0; i < NMSGS; i++) mq_send(consumer, i);
+  ipc_recv(NULL, NULL, NULL);
+  report("async", read_tsc() - start);
+}
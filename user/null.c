@@ -0,0 +1,5 @@
+// Exit right away, for measuring the cost of spawning an environment
+#include <inc/lib.h>
+
+void umain(int argc, char **argv) {
+}
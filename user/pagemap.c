@@ -0,0 +1,19 @@
+// Map a page at 10000 addresses, one system call at a time
+#include <inc/lib.h>
+
+#define NPAGES 10000
+#define SRCVA ((void*)0x10000000)
+#define DSTVA 0x20000000
+
+void umain(int argc, char **argv) {
+  int r;
+  if ((r = sys_page_alloc(0, SRCVA, PTE_P | PTE_U | PTE_W)) < 0) {
+    panic("sys_page_alloc: %e", r);
+  }
+  for (int i = 0; i < NPAGES; i++) {
+    void *va = (void*)(DSTVA + i * PGSIZE);
+    if ((r = sys_page_map(0, SRCVA, 0, va, PTE_P | PTE_U)) < 0) {
+      panic("sys_page_map: %e", r);
+    }
+  }
+}
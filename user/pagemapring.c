@@ -0,0 +1,33 @@
+// Map a page at 10000 addresses, in batches through the system call
+// rings
+#include <inc/lib.h>
+
+#define NPAGES 10000
+#define SRCVA ((void*)0x10000000)
+#define DSTVA 0x20000000
+#define RINGVA ((void*)0x0FFFF000)
+
+void umain(int argc, char **argv) {
+  int r;
+  if ((r = sys_page_alloc(0, SRCVA, PTE_P | PTE_U | PTE_W)) < 0) {
+    panic("sys_page_alloc: %e", r);
+  }
+  struct SysRing *ring = sysring_init(RINGVA);
+  if (!ring) panic("sysring_init failed");
+  
+  int queued = 0, completed = 0;
+  while (completed < NPAGES) {
+    while (queued < NPAGES && sysring_queue(ring, queued, SYS_page_map,
+          0, (uint32_t)SRCVA, 0, DSTVA + queued * PGSIZE, PTE_P | PTE_U)) {
+      queued++;
+    }
+    if ((r = sys_ring_enter()) < 0) panic("sys_ring_enter: %e", r);
+    struct SysCqe cqe;
+    while (sysring_complete(ring, &cqe)) {
+      if (cqe.cqe_result < 0) {
+        panic("sys_page_map of page %d: %e", cqe.cqe_data, cqe.cqe_result);
+      }
+      completed++;
+    }
+  }
+}
@@ -0,0 +1,39 @@
+// Pass data from a producer to a consumer through shared memory,
+// handing over only the length by IPC
+#include <inc/lib.h>
+
+#define NAME "shmpipe"
+#define SIZE (4 * PGSIZE)
+#define BUFVA ((uint8_t*)0x10000000)
+
+static void produce(envid_t consumer) {
+  int shmid = sys_shm_open(NAME, SIZE);
+  if (shmid < 0) panic("sys_shm_open: %e", shmid);
+  int r = sys_shm_map(shmid, BUFVA, PTE_P | PTE_U | PTE_W);
+  if (r < 0) panic("sys_shm_map: %e", r);
+  for (int i = 0; i < SIZE; i++) BUFVA[i] = i * 7;
+  ipc_send(consumer, SIZE, NULL, 0);
+}
+
+void umain(int argc, char **argv) {
+  // The object is opened before the fork, so that the producer finds it
+  int shmid = sys_shm_open(NAME, SIZE);
+  if (shmid < 0) panic("sys_shm_open: %e", shmid);
+  int r = sys_shm_map(shmid, BUFVA, PTE_P | PTE_U);
+  if (r < 0) panic("sys_shm_map: %e", r);
+  
+  envid_t consumer = sys_getenvid();
+  envid_t producer = sys_fork();
+  if (producer < 0) panic("sys_fork: %e", producer);
+  if (producer == 0) {
+    produce(consumer);
+    return;
+  }
+  
+  int len = ipc_recv(NULL, NULL, NULL);
+  for (int i = 0; i < len; i++) {
+    if (BUFVA[i] != (uint8_t)(i * 7)) panic("byte %d not shared", i);
+  }
+  cprintf("received %d bytes through shared memory\n", len);
+  sys_shm_close(shmid);
+}
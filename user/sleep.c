@@ -0,0 +1,48 @@
+// Sleep, and let blocking receives time out
+#include <inc/lib.h>
+#include <inc/x86.h>
+
+#define MQVA ((void*)0x10000000)
+#define TIMEOUT_US 10000
+
+// Take a call without replying, then send a late message
+static void child(envid_t parent) {
+  ipc_recv(NULL, NULL, NULL);
+  sys_env_sleep(TIMEOUT_US * 1000ULL);
+  ipc_send(parent, 42, NULL, 0);
+}
+
+void umain(int argc, char **argv) {
+  uint64_t start = read_tsc();
+  int r = sys_env_sleep(TIMEOUT_US * 1000ULL);
+  if (r < 0) panic("sys_env_sleep: %e", r);
+  cprintf("slept %d us in %llu cycles\n", TIMEOUT_US, read_tsc() - start);
+  
+  if ((r = sys_ipc_recv((void*)UTOP, TIMEOUT_US)) != -E_TIMEOUT) {
+    panic("sys_ipc_recv without sender: %e", r);
+  }
+  if (!mq_init(MQVA)) panic("mq_init failed");
+  if ((r = sys_mq_wait(TIMEOUT_US)) != -E_TIMEOUT) {
+    panic("sys_mq_wait without sender: %e", r);
+  }
+  
+  envid_t parent = sys_getenvid();
+  envid_t e = sys_fork();
+  if (e < 0) panic("sys_fork: %e", e);
+  if (e == 0) {
+    child(parent);
+    return;
+  }
+  // The child takes the call but does not reply in time
+  while ((r = sys_ipc_call(e, 0, (void*)UTOP, 0, (void*)UTOP, TIMEOUT_US)) ==
+      -E_IPC_NOT_RECV) {
+    sys_yield();
+  }
+  if (r != -E_TIMEOUT) panic("sys_ipc_call without reply: %e", r);
+  // Its late message still arrives within a longer timeout
+  if ((r = sys_ipc_recv((void*)UTOP, 100 * TIMEOUT_US)) < 0) {
+    panic("sys_ipc_recv: %e", r);
+  }
+  if (thisenv->env_ipc_value != 42) panic("wrong message");
+  cprintf("timeouts ok\n");
+}
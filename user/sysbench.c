@@ -0,0 +1,39 @@
+// Time a null system call through the stub at USYSCALL, which uses
+// sysenter if the CPU has it, and through int T_SYSCALL
+#include <inc/lib.h>
+#include <inc/x86.h>
+#include <inc/trap.h>
+
+#define NROUNDS 100
+#define NCALLS 100
+
+static void getenvid_int(void) {
+  int32_t ret;
+  asm volatile("int %1"
+    : "=a" (ret)
+    : "i" (T_SYSCALL), "a" (SYS_getenvid)
+    : "cc", "memory");
+}
+
+static void getenvid_stub(void) {
+  sys_getenvid();
+}
+
+// Print the fastest and the average cycles per call of `call`
+static void bench(const char *name, void (*call)(void)) {
+  uint64_t min = ~0ULL, total = 0;
+  for (int i = 0; i < NROUNDS; i++) {
+    uint64_t start = read_tsc();
+    for (int j = 0; j < NCALLS; j++) call();
+    uint64_t cycles = (read_tsc() - start) / NCALLS;
+    if (cycles < min) min = cycles;
+    total += cycles;
+  }
+  cprintf("null syscall %-8s %6llu cycles min, %6llu avg\n",
+      name, min, total / NROUNDS);
+}
+
+void umain(int argc, char **argv) {
+  bench("stub", getenvid_stub);
+  bench("int", getenvid_int);
+}